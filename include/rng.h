@@ -7,6 +7,7 @@
 
 typedef struct rng_state rng_state_t;
 
+// values are stable: new types are only ever appended
 typedef enum {
     RNG_XOSHIRO256PP,  // fast prng
     RNG_PCG32,         // small, decent prng
@@ -15,7 +16,18 @@ typedef enum {
     RNG_GAUSSIAN,      // normal dist
     RNG_GAMMA,         // gamma dist
     RNG_WEIBULL,       // weibull dist
-    RNG_POISSON        // poisson dist
+    RNG_POISSON,       // poisson dist
+    RNG_XOSHIRO256P,   // xoshiro256+, cheapest for doubles; weak low bits
+    RNG_XOROSHIRO128P, // xoroshiro128+, 128-bit state; weak low bits
+    RNG_SFC64,         // small fast chaotic, 256-bit state
+    RNG_WYRAND,        // 64-bit state, one multiply
+    RNG_ROMUTRIO,      // romu trio, 192-bit state
+    RNG_AES128CTR,     // aes-128 counter mode, aes-ni when available
+    RNG_ARS5,          // 5-round aes counter-based (random123 ars)
+    RNG_DSFMT,         // dsfmt-19937, native doubles (52-bit resolution)
+    RNG_SERVICE,       // shared-memory block ring client, see rng_service_connect
+    RNG_LFSR,          // prbs / lfsr bit pattern, params.lfsr.poly (default prbs31)
+    RNG_TRUNC_NORMAL   // normal restricted to [lo, hi], either bound may be infinite
 } rng_type_t;
 
 typedef union {
@@ -23,17 +35,316 @@ typedef union {
     struct { double shape, scale; } gamma;
     struct { double shape, scale; } weibull;
     struct { double lambda; } poisson;
+    struct { double mean, stddev, lo, hi; } trunc_normal;  // rng_init fails unless lo <= hi
+    struct { uint64_t poly; } lfsr;    // bit t-1 set for each x^t term, +1 implied
 } rng_params_t;
 
+// itu-t o.150 prbs polynomials for RNG_LFSR
+#define RNG_PRBS7  ((1ULL << 6) | (1ULL << 5))     // x^7 + x^6 + 1
+#define RNG_PRBS9  ((1ULL << 8) | (1ULL << 4))     // x^9 + x^5 + 1
+#define RNG_PRBS15 ((1ULL << 14) | (1ULL << 13))   // x^15 + x^14 + 1
+#define RNG_PRBS23 ((1ULL << 22) | (1ULL << 17))   // x^23 + x^18 + 1
+#define RNG_PRBS31 ((1ULL << 30) | (1ULL << 27))   // x^31 + x^28 + 1
+
+// per-state counters, only collected when the library is built with
+// -DRNG_STATS (make STATS=1); otherwise rng_stats returns 0 and zeros.
+typedef struct {
+    uint64_t draws;          // engine outputs handed out (words, doubles)
+    uint64_t bytes;          // bytes written by bulk fills
+    uint64_t regenerations;  // state/block refills: mt, dsfmt, aes buffer, service blocks
+    uint64_t samples;        // distribution samples
+    uint64_t rejections;     // rejected proposals inside the sampler
+    uint64_t cache_hits;     // samples served from the spare of a normal pair
+} rng_stats_t;
+
 rng_state_t* rng_init(rng_type_t type, uint64_t seed, rng_params_t* params);
 void rng_free(rng_state_t* state);
+rng_state_t* rng_clone(const rng_state_t* state);  // same stream from here on, NULL for RNG_SERVICE
 uint32_t rng_next_uint32(rng_state_t* state);
 uint64_t rng_next_uint64(rng_state_t* state);
+// narrow draws share a per-state bit reservoir, so one 64-bit engine word
+// serves two uint32, four uint16, eight uint8 or 64 bools. each takes the
+// top bits of the reservoir (RNG_LFSR: the low bits, in sequence order); a
+// remainder too short for the request is dropped and the reservoir refilled
+// from one engine word. the + engines only contribute their top 56 bits,
+// dsfmt its 52 mantissa bits, 32-bit engines one native word. uint64,
+// double and bulk fills bypass it; the last size % 8 bytes of
+// rng_fill_bytes are the low bytes of the next word, so fill_bytes(n) is a
+// prefix of fill_bytes(n + k).
+uint16_t rng_next_uint16(rng_state_t* state);
+uint8_t rng_next_uint8(rng_state_t* state);
+bool rng_next_bool(rng_state_t* state);
+uint32_t rng_next_bounded(rng_state_t* state, uint32_t bound);  // [0, bound)
 double rng_next_double(rng_state_t* state);
 double rng_next_distribution(rng_state_t* state);
 bool rng_fill_bytes(rng_state_t* state, void* buffer, size_t size);
+bool rng_fill_double(rng_state_t* state, double* out, size_t n);
+bool rng_fill_distribution(rng_state_t* state, double* out, size_t n);
 bool rng_analyze(rng_state_t* state, size_t sample_size, void* results);
 bool rng_reseed(rng_state_t* state, uint64_t seed);
 bool rng_jump(rng_state_t* state);
+bool rng_has_aesni(void);
+
+// fused transform chains: a source (uniform or gaussian over the chosen
+// engine) followed by scale / clamp stages and an optional terminal int16
+// quantizer. stages are folded as they are added, so run() makes a single
+// pass per block whatever the chain length. folding reassociates the
+// arithmetic, results can differ from stage-by-stage code in the last bit.
+typedef struct rng_pipeline rng_pipeline_t;
+rng_pipeline_t* rng_pipeline_create(rng_type_t engine, uint64_t seed);
+bool rng_pipeline_add_uniform(rng_pipeline_t* p, double lo, double hi);
+bool rng_pipeline_add_gaussian(rng_pipeline_t* p, double mean, double stddev);
+bool rng_pipeline_add_scale(rng_pipeline_t* p, double mul, double add);
+bool rng_pipeline_add_clamp(rng_pipeline_t* p, double lo, double hi);
+bool rng_pipeline_add_quantize_int16(rng_pipeline_t* p, double scale);
+bool rng_pipeline_run(rng_pipeline_t* p, void* out, size_t n);
+void rng_pipeline_free(rng_pipeline_t* p);
+
+// stochastic rounding and dither of float buffers, 16 random bits per
+// element from state. bf16/fp16 outputs are raw bit patterns; int8 rounds
+// in * scale and saturates; dither adds +-1 lsb tpdf noise to in * scale
+// before rounding to nearest.
+bool rng_round_bf16(rng_state_t* state, const float* in, uint16_t* out, size_t n);
+bool rng_round_fp16(rng_state_t* state, const float* in, uint16_t* out, size_t n);
+bool rng_round_int8(rng_state_t* state, const float* in, int8_t* out, size_t n, float scale);
+bool rng_dither_int16(rng_state_t* state, const float* in, int16_t* out, size_t n, float scale);
+
+// RNG_LFSR emits its bit sequence b[n] = xor of b[n - t] over the x^t terms,
+// 64 bits per word with the earliest in bit 0 (fill_bytes: lsb-first bytes;
+// next_bool yields the bits in order, next_uint8 the fill_bytes bytes).
+// the low degree bits of the seed are the initial window, 0 means all ones.
+// any fibonacci or galois register with the same characteristic polynomial
+// produces a phase of this sequence.
+bool rng_lfsr_jump(rng_state_t* state, uint64_t nbits);  // skip nbits, o(log nbits)
+// bit errors in a received pattern, self-synchronizing after the first
+// degree bits; each line error is counted once per polynomial term
+uint64_t rng_prbs_check(uint64_t poly, const void* data, size_t nbits);
+
+// fault injection over bit buffers (bit i = bit i % 8 of byte i / 8). events
+// hit each bit with probability rate, found by geometric gap sampling so the
+// cost is per event, not per bit. burst > 1 turns each event into a burst of
+// that length: first and last bit flipped, inner bits flipped with p 1/2.
+// the return value is the number of events.
+uint64_t rng_fault_inject(rng_state_t* state, void* buf, uint64_t nbits, double rate, uint32_t burst);
+// same over 2 mb chunks on num_threads threads (0 = all cpus), chunk i using
+// the task stream (seed, i); the result does not depend on the thread count
+uint64_t rng_fault_inject_parallel(rng_type_t type, uint64_t seed, void* buf, uint64_t nbits,
+                                   double rate, uint32_t burst, int num_threads);
+// exactly k random bits set out of nbits (cleared first), uniform over k-subsets
+bool rng_fault_mask(rng_state_t* state, void* mask, uint64_t nbits, uint64_t k);
+
+// dynamic discrete sampler (fenwick tree): index i with probability
+// w[i] / sum(w), weights changeable at any time. update and sample are
+// o(log n); negative or nan initial weights count as 0. infinite weights,
+// and creates or updates that would make the total infinite, are refused.
+typedef struct rng_weighted rng_weighted_t;
+rng_weighted_t* rng_weighted_create(size_t n, const double* weights);  // weights may be NULL
+bool rng_weighted_update(rng_weighted_t* t, size_t i, double w);
+double rng_weighted_get(const rng_weighted_t* t, size_t i);
+double rng_weighted_total(const rng_weighted_t* t);
+size_t rng_weighted_sample(const rng_weighted_t* t, rng_state_t* rng);  // SIZE_MAX if all 0
+void rng_weighted_free(rng_weighted_t* t);
+
+// importance sampling for rare events of a standard normal input x in dim
+// dimensions (map it to physical parameters in the score function). samples
+// come from the proposal N(shift, diag(scale^2)), default N(0, I), each with
+// its log likelihood ratio log p(x) / q(x). fn scores n rows of x (row-major)
+// into score; the event is score >= threshold.
+typedef struct rng_is rng_is_t;
+typedef void (*rng_is_score_fn)(const double* x, size_t n, size_t dim, double* score, void* ctx);
+typedef struct {
+    double estimate;    // event probability
+    double rel_err;     // relative standard error of the estimate
+    double ess;         // effective sample size of the hit weights
+    size_t n, hits;
+} rng_is_result_t;
+rng_is_t* rng_is_create(size_t dim, uint64_t seed);
+bool rng_is_set_proposal(rng_is_t* is, const double* shift, const double* scale);  // NULL = 0 / 1
+bool rng_is_get_proposal(const rng_is_t* is, double* shift, double* scale);
+bool rng_is_sample(rng_is_t* is, double* x, double* logw, size_t n);  // x is n * dim
+bool rng_is_estimate(rng_is_t* is, rng_is_score_fn fn, void* ctx, double threshold, size_t n,
+                     rng_is_result_t* out);
+// adaptive cross-entropy fit of the proposal with n samples per round and
+// elite fraction rho (0.1 is typical); rounds used, 0 if the level never
+// reached threshold within max_iter
+int rng_is_tune(rng_is_t* is, rng_is_score_fn fn, void* ctx, double threshold, size_t n,
+                double rho, int max_iter, bool fit_scale);
+void rng_is_free(rng_is_t* is);
+
+// multi-chain mcmc: K independent chains advanced in lockstep, stored as
+// struct-of-arrays (coordinate j of chain c at x[j * k + c]). fn gets the
+// k proposals of one batch and writes logp[k], and grad (same layout as x)
+// when grad is non-NULL, which only RNG_MCMC_HMC asks for. batches run
+// concurrently on worker threads. chain c uses its own stream, c jumps
+// past the first, so runs do not depend on the thread count.
+typedef enum {
+    RNG_MCMC_MH,     // random-walk metropolis, step = proposal stddev (default 2.38 / sqrt(dim))
+    RNG_MCMC_SLICE,  // hit-and-run slice sampler, step = initial bracket width (default 2)
+    RNG_MCMC_HMC     // hamiltonian, step = leapfrog size (default 0.2) over leapfrog steps (10)
+} rng_mcmc_kind_t;
+typedef void (*rng_logp_fn)(const double* x, size_t k, size_t dim, double* logp, double* grad, void* ctx);
+typedef struct rng_mcmc rng_mcmc_t;
+rng_mcmc_t* rng_mcmc_create(rng_mcmc_kind_t kind, size_t chains, size_t dim, rng_logp_fn fn,
+                            void* ctx, uint64_t seed);
+bool rng_mcmc_set_step(rng_mcmc_t* m, double step, int leapfrog);
+// positions are dim * chains, coordinate j of chain c at x[j * chains + c]; default 0
+bool rng_mcmc_set_position(rng_mcmc_t* m, const double* x);
+bool rng_mcmc_get_position(const rng_mcmc_t* m, double* x);
+// steps for every chain; with out, every thin-th position is appended to
+// out as one dim * chains snapshot (steps / thin of them)
+bool rng_mcmc_run(rng_mcmc_t* m, size_t steps, size_t thin, double* out, int num_threads);
+double rng_mcmc_acceptance(const rng_mcmc_t* m);      // over all steps so far
+double rng_mcmc_evals_per_step(const rng_mcmc_t* m);  // density evaluations per chain step
+void rng_mcmc_free(rng_mcmc_t* m);
+
+// particle resampling: m ancestor indices, ascending, drawn in proportion
+// to weights[n] (negative and nan count as 0; 0 if all are). O(n + m) with
+// one draw (systematic, residual) or m bulk-filled draws (stratified). the
+// weight prefix sum and the cdf / point merge are split over num_threads
+// (0 = all cpus) with merge-path partitioning; output is independent of it.
+typedef enum {
+    RNG_RESAMPLE_SYSTEMATIC,  // points (j + u) / m, one shared u
+    RNG_RESAMPLE_STRATIFIED,  // points (j + u_j) / m
+    RNG_RESAMPLE_RESIDUAL     // floor(m w) copies, remainder systematic on the fractions
+} rng_resample_kind_t;
+bool rng_resample(rng_state_t* state, rng_resample_kind_t kind, const double* weights, size_t n,
+                  size_t* out, size_t m, int num_threads);
+
+// stationary gaussian random fields on an nx x ny grid by circulant
+// embedding and a bundled radix-2 fft. cov(dx, dy, ctx) is the covariance
+// at a physical offset; the kernels below take an rng_cov_params_t ctx.
+// memory is about 24 bytes per embedding point (2 nx x 2 ny rounded up to
+// powers of two). each complex transform gives two independent fields.
+// transforms run on num_threads (0 = all cpus); fields depend only on the
+// seed. if the embedding stays indefinite after padding, the negative
+// eigenvalues are clipped and negative_mass reports their share (the
+// covariance is then approximate).
+typedef double (*rng_cov_fn)(double dx, double dy, void* ctx);
+typedef struct { double sigma, length; } rng_cov_params_t;
+double rng_cov_exponential(double dx, double dy, void* ctx);  // sigma^2 exp(-r / length)
+double rng_cov_gaussian(double dx, double dy, void* ctx);     // sigma^2 exp(-(r / length)^2)
+double rng_cov_matern32(double dx, double dy, void* ctx);     // matern nu = 3/2
+typedef struct rng_field rng_field_t;
+rng_field_t* rng_field_create(size_t nx, size_t ny, double spacing, rng_cov_fn cov, void* ctx,
+                              uint64_t seed, int num_threads);
+// a and b are nx * ny, a[x * ny + y]; b may be NULL (its field is returned next call)
+bool rng_field_generate(rng_field_t* f, double* a, double* b);
+double rng_field_negative_mass(const rng_field_t* f);
+void rng_field_free(rng_field_t* f);
+
+// arma(p, q) series x_t = sum phi_i x_{t-i} + e_t + sum theta_j e_{t-j},
+// e ~ N(0, sigma^2), for many independent series at once (struct-of-arrays,
+// sample t of series s at out[t * series + s]). series start in the
+// stationary distribution (lyapunov solve at create), so there is no
+// burn-in; create fails when the ar part is not stationary. long runs are
+// split into 4096-step blocks solved in parallel and stitched by the
+// linear recurrence; output does not depend on num_threads.
+typedef struct rng_arma rng_arma_t;
+rng_arma_t* rng_arma_create(size_t p, const double* phi, size_t q, const double* theta,
+                            double sigma, size_t series, uint64_t seed);
+bool rng_arma_generate(rng_arma_t* a, double* out, size_t len, int num_threads);  // continues
+bool rng_arma_reset(rng_arma_t* a, uint64_t seed);  // new stationary start and noise seed
+double rng_arma_variance(const rng_arma_t* a);     // stationary var(x_t)
+void rng_arma_free(rng_arma_t* a);
+
+// random projection without storing the matrix: R is d x k with entries of
+// variance 1 / k (so E |x R|^2 = |x|^2), regenerated tile by tile from
+// keyed hash streams inside a blocked multiply. entries depend only on the
+// seed and their position, never on num_threads (0 = all cpus), which
+// splits the work over output tiles. each tile of R is rebuilt once per
+// 128 data rows, so the cost is the multiply plus d * k / 128 draws per
+// output block row. achlioptas keeps a share density of entries at
+// +-1 / sqrt(k density), the rest 0 (density 0 = 1 / sqrt(d), "very
+// sparse"); its tiles are generated and applied by nonzeros only.
+typedef enum {
+    RNG_SKETCH_GAUSSIAN,    // N(0, 1 / k)
+    RNG_SKETCH_RADEMACHER,  // +-1 / sqrt(k)
+    RNG_SKETCH_ACHLIOPTAS   // sparse signs
+} rng_sketch_kind_t;
+typedef struct rng_sketch rng_sketch_t;
+rng_sketch_t* rng_sketch_create(rng_sketch_kind_t kind, size_t d, size_t k, double density,
+                                uint64_t seed);
+// y = x R: x is n x d, y is n x k, both row-major (projects n points)
+bool rng_sketch_apply(const rng_sketch_t* s, const double* x, size_t n, double* y, int num_threads);
+// y = R^T a: a is d x m, y is k x m, both row-major (sketches a tall matrix)
+bool rng_sketch_apply_left(const rng_sketch_t* s, const double* a, size_t m, double* y, int num_threads);
+// rows [row0, row0 + rows) of R into out (rows x k), e.g. to check or reuse them
+bool rng_sketch_rows(const rng_sketch_t* s, size_t row0, size_t rows, double* out);
+double rng_sketch_density(const rng_sketch_t* s);
+void rng_sketch_free(rng_sketch_t* s);
+
+// optional startup calibration: times the interchangeable kernels (aes
+// path, dsfmt recursion, fill chunk size) and keeps the fastest. results are
+// cached per cpu under $XDG_CACHE_HOME/rng-lib. never changes any stream,
+// and may run while other threads generate: the kernel switches are atomic.
+bool rng_autotune(void);
+
+// fused generation and consumption: total_n values are produced block_n at a
+// time (0 = 512, 4 kb) into a buffer owned by the state and handed to fn,
+// which may modify it and returns 0 to stop early. the values are those of
+// rng_fill_bytes / rng_fill_double / rng_fill_distribution over total_n.
+typedef enum { RNG_BLOCK_UINT64, RNG_BLOCK_DOUBLE, RNG_BLOCK_DISTRIBUTION } rng_block_kind_t;
+typedef bool (*rng_block_fn)(void* block, size_t n, void* ctx);
+#define RNG_BLOCK_DEFAULT 512
+bool rng_stream_blocks(rng_state_t* state, rng_block_kind_t kind, size_t total_n, size_t block_n,
+                       rng_block_fn fn, void* ctx);
+
+// fills of at least this many bytes use non-temporal stores so they do not
+// flush the cache. 0 restores the default (half the llc), SIZE_MAX disables.
+void rng_set_nt_threshold(size_t bytes);
+size_t rng_nt_threshold(void);
+
+bool rng_stats(rng_state_t* state, rng_stats_t* out);
+void rng_stats_reset(rng_state_t* state);
+
+// stateless keyed access: value at (seed, key, index), no sequential replay.
+// hierarchical keys nest with rng_hash_key, e.g. key(key(key(0, i), j), t).
+uint64_t rng_hash_key(uint64_t key, uint64_t sub);
+uint64_t rng_hash_at(uint64_t seed, uint64_t key, uint64_t index);
+void rng_hash_fill(uint64_t seed, uint64_t key, uint64_t first_index, size_t n, uint64_t* out);
+
+// work-stealing task runner. task i always gets a fresh stream derived from
+// (seed, i), so results do not depend on thread count or steal order.
+// num_threads <= 0 uses every online cpu. fn runs concurrently on workers.
+typedef void (*rng_task_fn)(rng_state_t* rng, size_t task_id, void* ctx);
+bool rng_run_tasks(rng_type_t type, uint64_t seed, rng_params_t* params, size_t num_tasks,
+                   int num_threads, rng_task_fn fn, void* ctx);
+int rng_num_cpus(void);
+
+// lock-free handle usable from any thread: each thread transparently gets
+// its own sub-stream (keyed by order of first use), so draws never contend.
+// seed 0 takes a clock seed once per handle. free only after all threads
+// are done with it. a thread's shard lives until the handle is freed, even
+// after the thread exits, so memory grows with every distinct thread that
+// ever used the handle: prefer long-lived threads (or rng_run_tasks).
+typedef struct rng_shared rng_shared_t;
+rng_shared_t* rng_shared_init(rng_type_t type, uint64_t seed, rng_params_t* params);
+void rng_shared_free(rng_shared_t* handle);
+rng_state_t* rng_shared_local(rng_shared_t* handle);
+uint32_t rng_shared_next_uint32(rng_shared_t* handle);
+uint64_t rng_shared_next_uint64(rng_shared_t* handle);
+double rng_shared_next_double(rng_shared_t* handle);
+double rng_shared_next_distribution(rng_shared_t* handle);
+bool rng_shared_fill_bytes(rng_shared_t* handle, void* buffer, size_t size);
+
+// shared-memory random block service. a producer (see rngd) fills a ring of
+// blocks under a shm name; each block goes to exactly one client. clients
+// read through the normal rng_next_* / rng_fill_* calls and fall back to a
+// local engine whenever the ring is empty or the service is absent (or its
+// header is malformed). the ring is created mode 0600, so clients must run
+// as the producer's user. create replaces a ring whose producer has died and
+// fails while the producer that owns the name is alive. a client killed in
+// the middle of copying a block holds its slot for good; the producer stops
+// there and clients fall back to local engines until it is restarted.
+typedef struct rng_service rng_service_t;
+rng_service_t* rng_service_create(const char* name, rng_type_t type, uint64_t seed,
+                                  size_t block_size, size_t num_blocks);
+size_t rng_service_pump(rng_service_t* svc);
+// blocks while the ring is full, until a client takes a block (1) or
+// timeout_ms passes (0)
+bool rng_service_wait(rng_service_t* svc, int timeout_ms);
+void rng_service_free(rng_service_t* svc);
+rng_state_t* rng_service_connect(const char* name, rng_type_t fallback, uint64_t seed);
+bool rng_service_counts(rng_state_t* state, uint64_t* served, uint64_t* local);
 
 #endif
@@ -1,21 +1,72 @@
+#define _POSIX_C_SOURCE 200809L
 #include "rng.h"
+#include "rng_aes.h"
+#include "rng_dsfmt.h"
+#include "rng_lfsr.h"
+#include "rng_service.h"
+#include "rng_tune.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define PI 3.14159265358979323846
+#define GOLDEN_GAMMA 0x9e3779b97f4a7c15ULL
+#define CACHE_LINE 64
+
+typedef struct { uint64_t s[4]; } xoshiro256_t;
+typedef struct { uint64_t s[2]; } xoroshiro128_t;
+typedef struct { uint64_t a, b, c, counter; } sfc64_t;
+typedef struct { uint64_t s; } wyrand_t;
+typedef struct { uint64_t x, y, z; } romutrio_t;
+
+#ifdef RNG_STATS
+#define STAT_ADD(st, field, n) ((st)->stats.field += (n))
+#else
+#define STAT_ADD(st, field, n) ((void)(st), (void)(n))
+#endif
 
 struct rng_state {
     rng_type_t type;
     rng_params_t params;
+    void* block;                   // rng_stream_blocks buffer, grown on demand
+    size_t block_cap;
+    uint64_t res;                  // bit reservoir, left-aligned (right-aligned for lfsr)
+    uint32_t res_bits;
+#ifdef RNG_STATS
+    rng_stats_t stats;
+#endif
     union {
-        struct { uint64_t s[4]; } xoshiro256pp;
+        xoshiro256_t xoshiro256;   // ++ and + share the linear engine
+        xoroshiro128_t xoroshiro128;
+        sfc64_t sfc64;
+        wyrand_t wyrand;
+        romutrio_t romutrio;
+        aes_ctr_t aes;             // aes-128-ctr and ars-5
+        dsfmt_t dsfmt;
+        lfsr_t lfsr;
         struct { uint64_t state, inc; } pcg32;
         struct { uint32_t state[16]; uint32_t pos; } chacha20;
         struct { uint32_t state[624]; int idx; } mt19937;
         struct { bool has_cache; double cache; rng_state_t* base; } gaussian;
-        struct { rng_state_t* base; } other_dist;
+        struct {
+            rng_state_t* base;
+            bool has_cache;
+            double cache;
+            struct { int method; double a, b, sign, k; } trunc;  // RNG_TRUNC_NORMAL, set at init
+        } other_dist;
+        struct {
+            svc_client_t client;
+            uint8_t* buf;
+            size_t size, pos;       // buffered block, bytes consumed
+            rng_state_t* local;     // fallback when the ring is empty or absent
+            uint64_t served, fallback;
+        } service;
     } state;
 };
 
@@ -23,15 +74,120 @@ static inline uint64_t rotl(uint64_t x, int k) {
     return (x << k) | (x >> (64 - k));
 }
 
-static uint64_t xoshiro256pp_next(rng_state_t* state) {
-    uint64_t* s = state->state.xoshiro256pp.s;
-    uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t splitmix64(uint64_t* x) {
+    return mix64(*x += GOLDEN_GAMMA);
+}
+
+static inline void xoshiro256_step(xoshiro256_t* x) {
+    uint64_t* s = x->s;
     uint64_t t = s[1] << 17;
     s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
     s[2] ^= t; s[3] = rotl(s[3], 45);
+}
+
+static inline uint64_t xoshiro256pp_step(xoshiro256_t* x) {
+    uint64_t result = rotl(x->s[0] + x->s[3], 23) + x->s[0];
+    xoshiro256_step(x);
     return result;
 }
 
+static inline uint64_t xoshiro256p_step(xoshiro256_t* x) {
+    uint64_t result = x->s[0] + x->s[3];
+    xoshiro256_step(x);
+    return result;
+}
+
+static inline uint64_t xoroshiro128p_step(xoroshiro128_t* x) {
+    uint64_t s0 = x->s[0], s1 = x->s[1];
+    uint64_t result = s0 + s1;
+    s1 ^= s0;
+    x->s[0] = rotl(s0, 24) ^ s1 ^ (s1 << 16);
+    x->s[1] = rotl(s1, 37);
+    return result;
+}
+
+static inline uint64_t sfc64_step(sfc64_t* x) {
+    uint64_t tmp = x->a + x->b + x->counter++;
+    x->a = x->b ^ (x->b >> 11);
+    x->b = x->c + (x->c << 3);
+    x->c = rotl(x->c, 24) + tmp;
+    return tmp;
+}
+
+static inline uint64_t mul_fold64(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)(r >> 64) ^ (uint64_t)r;
+#else
+    uint64_t ha = a >> 32, la = (uint32_t)a, hb = b >> 32, lb = (uint32_t)b;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t mid = (ll >> 32) + (uint32_t)hl + (uint32_t)lh;
+    uint64_t lo = (mid << 32) | (uint32_t)ll;
+    uint64_t hi = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+    return hi ^ lo;
+#endif
+}
+
+static inline uint64_t wyrand_step(wyrand_t* x) {
+    x->s += 0xa0761d6478bd642fULL;
+    return mul_fold64(x->s, x->s ^ 0xe7037ed1a0b428dbULL);
+}
+
+static inline uint64_t romutrio_step(romutrio_t* r) {
+    uint64_t xp = r->x, yp = r->y, zp = r->z;
+    r->x = 15241094284759029579ULL * zp;
+    r->y = rotl(yp - xp, 12);
+    r->z = rotl(zp - yp, 44);
+    return xp;
+}
+
+static uint64_t aes_next(rng_state_t* state) {
+    aes_ctr_t* x = &state->state.aes;
+    if (x->pos >= 2 * AES_BUF_BLOCKS) {
+        aes_ctr_blocks(x, (uint8_t*)x->buf, AES_BUF_BLOCKS);
+        x->pos = 0;
+        STAT_ADD(state, regenerations, 1);
+    }
+    return x->buf[x->pos++];
+}
+
+// one block from the shared ring, or from the local engine if none is ready
+static void service_block(rng_state_t* state, void* dst) {
+    STAT_ADD(state, regenerations, 1);
+    if (svc_client_claim(&state->state.service.client, dst)) {
+        state->state.service.served++;
+    } else {
+        rng_fill_bytes(state->state.service.local, dst, state->state.service.size);
+        state->state.service.fallback++;
+    }
+}
+
+static uint64_t service_next(rng_state_t* state) {
+    if (state->state.service.pos + 8 > state->state.service.size) {
+        service_block(state, state->state.service.buf);
+        state->state.service.pos = 0;
+    }
+    uint64_t v;
+    memcpy(&v, state->state.service.buf + state->state.service.pos, 8);
+    state->state.service.pos += 8;
+    return v;
+}
+
+static uint64_t dsfmt_raw(rng_state_t* state) {
+    if (state->state.dsfmt.idx >= DSFMT_N64) STAT_ADD(state, regenerations, 1);
+    return dsfmt_next_raw(&state->state.dsfmt);
+}
+
+static uint64_t xoshiro256pp_next(rng_state_t* state) {
+    return xoshiro256pp_step(&state->state.xoshiro256);
+}
+
 static uint32_t pcg32_next(rng_state_t* state) {
     uint64_t old = state->state.pcg32.state;
     state->state.pcg32.state = old * 6364136223846793005ULL + state->state.pcg32.inc;
@@ -43,6 +199,7 @@ static uint32_t pcg32_next(rng_state_t* state) {
 static uint32_t chacha20_next(rng_state_t* state) {
     if (state->state.chacha20.pos >= 16) {
         state->state.chacha20.pos = 0; // placeholder, real chacha20 needs more
+        STAT_ADD(state, regenerations, 1);
     }
     return state->state.chacha20.state[state->state.chacha20.pos++];
 }
@@ -64,6 +221,7 @@ static void mt_gen(rng_state_t* state) {
         if (y % 2) mt[i] ^= 0x9908b0dfUL;
     }
     state->state.mt19937.idx = 0;
+    STAT_ADD(state, regenerations, 1);
 }
 
 static uint32_t mt19937_next(rng_state_t* state) {
@@ -74,25 +232,56 @@ static uint32_t mt19937_next(rng_state_t* state) {
     return y;
 }
 
-static double gen_gaussian(rng_state_t* state) {
-    if (state->state.gaussian.has_cache) {
-        state->state.gaussian.has_cache = 0;
-        return state->state.gaussian.cache;
+static rng_state_t* dist_base(rng_state_t* state) {
+    switch (state->type) {
+        case RNG_GAUSSIAN: return state->state.gaussian.base;
+        case RNG_GAMMA:
+        case RNG_WEIBULL:
+        case RNG_POISSON:
+        case RNG_TRUNC_NORMAL: return state->state.other_dist.base;
+        default: return NULL;
     }
-    double u1, u2, r, z0, z1;
-    rng_state_t* base = state->state.gaussian.base;
-    do {
+}
+
+// marsaglia polar pair of standard normals from base; rejections are
+// charged to the sampler state
+static double polar_pair(rng_state_t* state, rng_state_t* base, double* z1) {
+    double u1, u2, r;
+    for (;;) {
         u1 = 2.0 * rng_next_double(base) - 1.0;
         u2 = 2.0 * rng_next_double(base) - 1.0;
         r = u1 * u1 + u2 * u2;
-    } while (r >= 1.0 || r == 0.0);
+        if (r < 1.0 && r != 0.0) break;
+        STAT_ADD(state, rejections, 1);
+    }
     r = sqrt(-2.0 * log(r) / r);
-    z0 = u1 * r; z1 = u2 * r;
+    *z1 = u2 * r;
+    return u1 * r;
+}
+
+static double gen_gaussian(rng_state_t* state) {
+    if (state->state.gaussian.has_cache) {
+        state->state.gaussian.has_cache = 0;
+        STAT_ADD(state, cache_hits, 1);
+        return state->state.gaussian.cache;
+    }
+    double z0, z1;
+    z0 = polar_pair(state, state->state.gaussian.base, &z1);
     state->state.gaussian.has_cache = 1;
     state->state.gaussian.cache = state->params.gaussian.mean + state->params.gaussian.stddev * z1;
     return state->params.gaussian.mean + state->params.gaussian.stddev * z0;
 }
 
+static double cached_normal(rng_state_t* state) {
+    if (state->state.other_dist.has_cache) {
+        state->state.other_dist.has_cache = 0;
+        STAT_ADD(state, cache_hits, 1);
+        return state->state.other_dist.cache;
+    }
+    state->state.other_dist.has_cache = 1;
+    return polar_pair(state, state->state.other_dist.base, &state->state.other_dist.cache);
+}
+
 static double gen_gamma(rng_state_t* state) {
     double shape = state->params.gamma.shape, scale = state->params.gamma.scale;
     if (shape < 1.0) {
@@ -107,17 +296,21 @@ static double gen_gamma(rng_state_t* state) {
                 x = -log((1.0 - u) / shape);
                 if (v <= pow(x, shape - 1.0)) return x * scale;
             }
+            STAT_ADD(state, rejections, 1);
         } while (1);
     }
     double d = shape - 1.0/3.0, c = 1.0 / sqrt(9.0 * d), x, v, u;
     do {
-        do {
-            x = gen_gaussian(state->state.other_dist.base);
+        for (;;) {
+            x = cached_normal(state);
             v = 1.0 + c * x;
-        } while (v <= 0.0);
+            if (v > 0.0) break;
+            STAT_ADD(state, rejections, 1);
+        }
         v = v * v * v; u = rng_next_double(state->state.other_dist.base);
         if (u < 1.0 - 0.0331 * (x * x) * (x * x)) return d * v * scale;
         if (log(u) < 0.5 * x * x + d * (1.0 - v + log(v))) return d * v * scale;
+        STAT_ADD(state, rejections, 1);
     } while (1);
 }
 
@@ -136,23 +329,166 @@ static double gen_poisson(rng_state_t* state) {
     return k - 1;
 }
 
-rng_state_t* rng_init(rng_type_t type, uint64_t seed, rng_params_t* params) {
-    rng_state_t* state = malloc(sizeof(rng_state_t));
-    if (!state) return NULL;
-    memset(state, 0, sizeof(rng_state_t));
-    state->type = type;
-    if (seed == 0) seed = (uint64_t)time(NULL);
-    if (params) memcpy(&state->params, params, sizeof(rng_params_t));
+// truncated normal, drawn as z on the standardized interval [a, b]. an
+// interval below 0 is mirrored onto a >= 0, so the tail samplers only see
+// right tails. the method and its constant k are picked once per interval:
+//   TN_NORMAL   holds 0, wider than sqrt(2 pi): normal draws until inside
+//   TN_UNIFORM  short interval: uniform proposal, accept exp((k - z^2) / 2)
+//   TN_EXP      robert's exponential proposal at the optimal rate k
+//   TN_TAIL     marsaglia's tail method from a = 3 on, no exp per proposal
+// each accepts with probability bounded away from 0 wherever [a, b] sits,
+// so a sample costs O(1) expected draws even 20 sigma out.
+enum { TN_POINT, TN_NORMAL, TN_UNIFORM, TN_EXP, TN_TAIL };
+#define TN_TAIL_A 3.0  // robert and marsaglia both accept > 85% past here
+
+static bool trunc_setup(rng_state_t* state) {
+    double mean = state->params.trunc_normal.mean, sd = state->params.trunc_normal.stddev;
+    double lo = state->params.trunc_normal.lo, hi = state->params.trunc_normal.hi;
+    if (!isfinite(mean) || !isfinite(sd) || !(sd > 0.0) || !(lo <= hi) || lo == INFINITY ||
+        hi == -INFINITY)
+        return 0;
+    double a = (lo - mean) / sd, b = (hi - mean) / sd, r;
+    int method;
+    state->state.other_dist.trunc.sign = 1.0;
+    state->state.other_dist.trunc.k = 0.0;
+    if (lo == hi) {
+        method = TN_POINT;
+    } else {
+        if (b <= 0.0) {
+            double t = a;
+            a = -b; b = -t;
+            state->state.other_dist.trunc.sign = -1.0;
+        }
+        r = sqrt(a * a + 4.0);
+        if (a < 0.0) {
+            method = b - a >= sqrt(2.0 * PI) ? TN_NORMAL : TN_UNIFORM;
+        } else if (b - a < 2.0 * exp(0.5 + 0.25 * (a * a - a * r)) / (a + r)) {
+            // robert's bound: below this width the flat proposal wins
+            method = TN_UNIFORM;
+            state->state.other_dist.trunc.k = a * a;
+        } else if (a >= TN_TAIL_A) {
+            method = TN_TAIL;
+        } else {
+            method = TN_EXP;
+            state->state.other_dist.trunc.k = 0.5 * (a + r);
+        }
+    }
+    state->state.other_dist.trunc.method = method;
+    state->state.other_dist.trunc.a = a;
+    state->state.other_dist.trunc.b = b;
+    return 1;
+}
+
+static inline double tn_normal(rng_state_t* state, double a, double b) {
+    for (;;) {
+        double z = cached_normal(state);
+        if (z >= a && z <= b) return z;
+        STAT_ADD(state, rejections, 1);
+    }
+}
+
+static inline double tn_uniform(rng_state_t* state, double a, double b, double k) {
+    rng_state_t* base = state->state.other_dist.base;
+    for (;;) {
+        double z = a + (b - a) * rng_next_double(base);
+        if (rng_next_double(base) <= exp(0.5 * (k - z * z))) return z;
+        STAT_ADD(state, rejections, 1);
+    }
+}
+
+static inline double tn_exp(rng_state_t* state, double a, double b, double k) {
+    rng_state_t* base = state->state.other_dist.base;
+    for (;;) {
+        double z = a - log(1.0 - rng_next_double(base)) / k;
+        double v = rng_next_double(base);
+        if (z <= b && v <= exp(-0.5 * (z - k) * (z - k))) return z;
+        STAT_ADD(state, rejections, 1);
+    }
+}
+
+static inline double tn_tail(rng_state_t* state, double a, double b) {
+    rng_state_t* base = state->state.other_dist.base;
+    for (;;) {
+        double x = sqrt(a * a - 2.0 * log(1.0 - rng_next_double(base)));
+        double v = rng_next_double(base);
+        if (x <= b && v * x <= a) return x;
+        STAT_ADD(state, rejections, 1);
+    }
+}
+
+static double gen_trunc_normal(rng_state_t* state) {
+    double a = state->state.other_dist.trunc.a, b = state->state.other_dist.trunc.b;
+    double k = state->state.other_dist.trunc.k, z;
+    switch (state->state.other_dist.trunc.method) {
+        case TN_NORMAL: z = tn_normal(state, a, b); break;
+        case TN_UNIFORM: z = tn_uniform(state, a, b, k); break;
+        case TN_EXP: z = tn_exp(state, a, b, k); break;
+        case TN_TAIL: z = tn_tail(state, a, b); break;
+        default: return state->params.trunc_normal.lo;
+    }
+    return state->params.trunc_normal.mean +
+           state->state.other_dist.trunc.sign * state->params.trunc_normal.stddev * z;
+}
+
+// batch path: one method switch per call, constants held in registers
+static void fill_trunc_normal(rng_state_t* state, double* out, size_t n) {
+    double a = state->state.other_dist.trunc.a, b = state->state.other_dist.trunc.b;
+    double k = state->state.other_dist.trunc.k;
+    double mean = state->params.trunc_normal.mean;
+    double sd = state->state.other_dist.trunc.sign * state->params.trunc_normal.stddev;
+    size_t i = 0;
+    switch (state->state.other_dist.trunc.method) {
+        case TN_NORMAL: for (; i < n; i++) out[i] = mean + sd * tn_normal(state, a, b); break;
+        case TN_UNIFORM: for (; i < n; i++) out[i] = mean + sd * tn_uniform(state, a, b, k); break;
+        case TN_EXP: for (; i < n; i++) out[i] = mean + sd * tn_exp(state, a, b, k); break;
+        case TN_TAIL: for (; i < n; i++) out[i] = mean + sd * tn_tail(state, a, b); break;
+        default: for (; i < n; i++) out[i] = state->params.trunc_normal.lo; break;
+    }
+}
+
+// (re)seeds the engine part of a state in place, 0 for distribution types
+static bool seed_engine(rng_state_t* state, uint64_t seed) {
+    rng_type_t type = state->type;
     switch (type) {
         case RNG_XOSHIRO256PP:
             uint64_t z = seed;
             for (int i = 0; i < 4; i++) {
-                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
-                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
-                z = z ^ (z >> 31);
-                state->state.xoshiro256pp.s[i] = z;
+                z = mix64(z);
+                state->state.xoshiro256.s[i] = z;
             }
             break;
+        case RNG_XOSHIRO256P:
+            for (int i = 0; i < 4; i++) state->state.xoshiro256.s[i] = splitmix64(&seed);
+            break;
+        case RNG_XOROSHIRO128P:
+            state->state.xoroshiro128.s[0] = splitmix64(&seed);
+            state->state.xoroshiro128.s[1] = splitmix64(&seed);
+            break;
+        case RNG_SFC64:
+            state->state.sfc64.a = state->state.sfc64.b = state->state.sfc64.c = seed;
+            state->state.sfc64.counter = 1;
+            for (int i = 0; i < 12; i++) sfc64_step(&state->state.sfc64);
+            break;
+        case RNG_WYRAND:
+            state->state.wyrand.s = seed;
+            break;
+        case RNG_ROMUTRIO:
+            state->state.romutrio.x = splitmix64(&seed);
+            state->state.romutrio.y = splitmix64(&seed);
+            state->state.romutrio.z = splitmix64(&seed);
+            break;
+        case RNG_AES128CTR:
+        case RNG_ARS5: {
+            uint64_t k0 = splitmix64(&seed), k1 = splitmix64(&seed);
+            aes_ctr_seed(&state->state.aes, k0, k1, type == RNG_ARS5);
+            break;
+        }
+        case RNG_DSFMT:
+            dsfmt_seed(&state->state.dsfmt, (uint32_t)(seed ^ (seed >> 32)));
+            break;
+        case RNG_LFSR:
+            lfsr_seed(&state->state.lfsr, seed);
+            break;
         case RNG_PCG32:
             state->state.pcg32.state = seed;
             state->state.pcg32.inc = (seed << 1) | 1;
@@ -166,6 +502,31 @@ rng_state_t* rng_init(rng_type_t type, uint64_t seed, rng_params_t* params) {
         case RNG_MT19937:
             mt_init(state, (uint32_t)seed);
             break;
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+// zeroed state on whole cache lines of its own, so states of different
+// threads (rng_shared shards, per-thread states of the caller) never
+// share a line
+static rng_state_t* state_alloc(void) {
+    void* mem = NULL;
+    size_t size = (sizeof(rng_state_t) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    if (posix_memalign(&mem, CACHE_LINE, size)) return NULL;
+    memset(mem, 0, size);
+    return mem;
+}
+
+rng_state_t* rng_init(rng_type_t type, uint64_t seed, rng_params_t* params) {
+    rng_state_t* state = state_alloc();
+    if (!state) return NULL;
+    state->type = type;
+    // lfsr seed 0 is the documented all-ones window, not a clock seed
+    if (seed == 0 && type != RNG_LFSR) seed = (uint64_t)time(NULL);
+    if (params) memcpy(&state->params, params, sizeof(rng_params_t));
+    switch (type) {
         case RNG_GAUSSIAN:
             state->state.gaussian.base = rng_init(RNG_XOSHIRO256PP, seed, NULL);
             state->state.gaussian.has_cache = 0;
@@ -175,9 +536,26 @@ rng_state_t* rng_init(rng_type_t type, uint64_t seed, rng_params_t* params) {
         case RNG_POISSON:
             state->state.other_dist.base = rng_init(RNG_XOSHIRO256PP, seed, NULL);
             break;
+        case RNG_TRUNC_NORMAL:
+            if (!trunc_setup(state)) {
+                free(state);
+                return NULL;
+            }
+            state->state.other_dist.base = rng_init(RNG_XOSHIRO256PP, seed, NULL);
+            break;
+        case RNG_LFSR:
+            if (!lfsr_init(&state->state.lfsr, params ? params->lfsr.poly : RNG_PRBS31)) {
+                free(state);
+                return NULL;
+            }
+            seed_engine(state, seed);
+            break;
         default:
-            free(state);
-            return NULL;
+            if (!seed_engine(state, seed)) {
+                free(state);
+                return NULL;
+            }
+            break;
     }
     return state;
 }
@@ -191,112 +569,483 @@ void rng_free(rng_state_t* state) {
         case RNG_GAMMA:
         case RNG_WEIBULL:
         case RNG_POISSON:
+        case RNG_TRUNC_NORMAL:
             rng_free(state->state.other_dist.base);
             break;
+        case RNG_SERVICE:
+            svc_client_close(&state->state.service.client);
+            rng_free(state->state.service.local);
+            free(state->state.service.buf);
+            break;
+        case RNG_LFSR:
+            lfsr_free(&state->state.lfsr);
+            break;
         default:
             break;
     }
+    free(state->block);
     free(state);
 }
 
-uint32_t rng_next_uint32(rng_state_t* state) {
-    if (!state) return 0;
+// deep copy with buffered output and reservoir, so the copy continues the
+// same stream; rng_jump it for a disjoint one. service clients own a ring
+// mapping and cannot be copied.
+rng_state_t* rng_clone(const rng_state_t* state) {
+    if (!state || state->type == RNG_SERVICE) return NULL;
+    rng_state_t* c = state_alloc();
+    if (!c) return NULL;
+    memcpy(c, state, sizeof(rng_state_t));
+    c->block = NULL;
+    c->block_cap = 0;
+    bool ok = 1;
     switch (state->type) {
-        case RNG_XOSHIRO256PP: return (uint32_t)(xoshiro256pp_next(state) & 0xFFFFFFFF);
-        case RNG_PCG32: return pcg32_next(state);
-        case RNG_CHACHA20: return chacha20_next(state);
-        case RNG_MT19937: return mt19937_next(state);
-        case RNG_GAUSSIAN: return rng_next_uint32(state->state.gaussian.base);
+        case RNG_GAUSSIAN:
+            ok = (c->state.gaussian.base = rng_clone(state->state.gaussian.base)) != NULL;
+            break;
         case RNG_GAMMA:
         case RNG_WEIBULL:
-        case RNG_POISSON: return rng_next_uint32(state->state.other_dist.base);
-        default: return 0;
+        case RNG_POISSON:
+        case RNG_TRUNC_NORMAL:
+            ok = (c->state.other_dist.base = rng_clone(state->state.other_dist.base)) != NULL;
+            break;
+        case RNG_LFSR: {
+            size_t size = (size_t)((state->state.lfsr.degree + 7) >> 3) * sizeof(*state->state.lfsr.tab);
+            c->state.lfsr.tab = malloc(size);
+            if (c->state.lfsr.tab) memcpy(c->state.lfsr.tab, state->state.lfsr.tab, size);
+            ok = c->state.lfsr.tab != NULL;
+            break;
+        }
+        default:
+            break;
     }
+    if (!ok) {
+        free(c);
+        return NULL;
+    }
+    return c;
 }
 
-uint64_t rng_next_uint64(rng_state_t* state) {
-    if (!state) return 0;
+static uint64_t engine_next_uint64(rng_state_t* state) {
     switch (state->type) {
         case RNG_XOSHIRO256PP: return xoshiro256pp_next(state);
+        case RNG_XOSHIRO256P: return xoshiro256p_step(&state->state.xoshiro256);
+        case RNG_XOROSHIRO128P: return xoroshiro128p_step(&state->state.xoroshiro128);
+        case RNG_SFC64: return sfc64_step(&state->state.sfc64);
+        case RNG_WYRAND: return wyrand_step(&state->state.wyrand);
+        case RNG_ROMUTRIO: return romutrio_step(&state->state.romutrio);
+        case RNG_AES128CTR:
+        case RNG_ARS5: return aes_next(state);
+        case RNG_SERVICE: return service_next(state);
+        case RNG_LFSR: return lfsr_step(&state->state.lfsr);
         case RNG_PCG32: return ((uint64_t)pcg32_next(state) << 32) | pcg32_next(state);
         case RNG_CHACHA20: return ((uint64_t)chacha20_next(state) << 32) | chacha20_next(state);
         case RNG_MT19937: return ((uint64_t)mt19937_next(state) << 32) | mt19937_next(state);
-        case RNG_GAUSSIAN: return rng_next_uint64(state->state.gaussian.base);
-        case RNG_GAMMA:
-        case RNG_WEIBULL:
-        case RNG_POISSON: return rng_next_uint64(state->state.other_dist.base);
+        case RNG_DSFMT: {
+            // each draw carries 52 random mantissa bits
+            uint64_t hi = dsfmt_raw(state) & 0x000fffffffffffffULL;
+            return (hi << 12) ^ (dsfmt_raw(state) & 0x000fffffffffffffULL);
+        }
         default: return 0;
     }
 }
 
+// bit reservoir behind the narrow draws (uint32, uint16, uint8, bool,
+// bounded). a draw of w bits takes the top w bits of the reservoir; when
+// fewer than w are left they are dropped and one engine word refills it.
+// usable bits per word: 32 for the 32-bit engines, 52 for dsfmt (mantissa),
+// the top 56 for the + scramblers (weak low bits), 64 otherwise. uint64,
+// double and bulk fills never touch the reservoir; reseed and jump empty it.
+// RNG_LFSR takes the low bits instead, so narrow draws keep its bit order:
+// bools are the sequence and uint8 draws the bytes fill_bytes would write.
+static void res_refill(rng_state_t* state) {
+    STAT_ADD(state, draws, 1);
+    switch (state->type) {
+        case RNG_PCG32: state->res = (uint64_t)pcg32_next(state) << 32; state->res_bits = 32; break;
+        case RNG_CHACHA20: state->res = (uint64_t)chacha20_next(state) << 32; state->res_bits = 32; break;
+        case RNG_MT19937: state->res = (uint64_t)mt19937_next(state) << 32; state->res_bits = 32; break;
+        case RNG_DSFMT: state->res = dsfmt_raw(state) << 12; state->res_bits = 52; break;
+        case RNG_XOSHIRO256P:
+        case RNG_XOROSHIRO128P: state->res = engine_next_uint64(state); state->res_bits = 56; break;
+        default: state->res = engine_next_uint64(state); state->res_bits = 64; break;
+    }
+}
+
+static inline uint32_t take_bits(rng_state_t* state, uint32_t w) {
+    rng_state_t* base = dist_base(state);
+    if (base) state = base;
+    if (state->res_bits < w) res_refill(state);
+    uint32_t v;
+    if (state->type == RNG_LFSR) {
+        v = (uint32_t)(state->res & (~0ULL >> (64 - w)));
+        state->res >>= w;
+    } else {
+        v = (uint32_t)(state->res >> (64 - w));
+        state->res <<= w;
+    }
+    state->res_bits -= w;
+    return v;
+}
+
+// distribution states forward raw draws to their base engine, which does
+// the counting, so nothing is counted twice
+uint32_t rng_next_uint32(rng_state_t* state) {
+    if (!state) return 0;
+    return take_bits(state, 32);
+}
+
+uint16_t rng_next_uint16(rng_state_t* state) {
+    if (!state) return 0;
+    return (uint16_t)take_bits(state, 16);
+}
+
+uint8_t rng_next_uint8(rng_state_t* state) {
+    if (!state) return 0;
+    return (uint8_t)take_bits(state, 8);
+}
+
+bool rng_next_bool(rng_state_t* state) {
+    if (!state) return 0;
+    return take_bits(state, 1);
+}
+
+// uniform in [0, bound) by lemire's multiply-shift with rejection, on 16
+// reservoir bits for bounds up to 256 and 32 bits above
+uint32_t rng_next_bounded(rng_state_t* state, uint32_t bound) {
+    if (!state || bound <= 1) return 0;
+    uint32_t w = bound <= 256 ? 16 : 32;
+    uint64_t range = (uint64_t)1 << w, mask = range - 1;
+    uint64_t m = (uint64_t)take_bits(state, w) * bound;
+    if ((m & mask) < bound) {
+        uint64_t t = (range - bound) % bound;
+        while ((m & mask) < t) m = (uint64_t)take_bits(state, w) * bound;
+    }
+    return (uint32_t)(m >> w);
+}
+
+uint64_t rng_next_uint64(rng_state_t* state) {
+    if (!state) return 0;
+    rng_state_t* base = dist_base(state);
+    if (base) return rng_next_uint64(base);
+    STAT_ADD(state, draws, 1);
+    return engine_next_uint64(state);
+}
+
 double rng_next_double(rng_state_t* state) {
     if (!state) return 0.0;
-    uint64_t x = rng_next_uint64(state);
+    rng_state_t* base = dist_base(state);
+    if (base) return rng_next_double(base);
+    STAT_ADD(state, draws, 1);
+    if (state->type == RNG_DSFMT) {
+        uint64_t raw = dsfmt_raw(state);
+        double d;
+        memcpy(&d, &raw, 8);
+        return d - 1.0;
+    }
+    uint64_t x = engine_next_uint64(state);
     return (double)(x >> 11) * (1.0/9007199254740992.0);
 }
 
 double rng_next_distribution(rng_state_t* state) {
     if (!state) return 0.0;
+    if (dist_base(state)) STAT_ADD(state, samples, 1);
     switch (state->type) {
         case RNG_GAUSSIAN: return gen_gaussian(state);
         case RNG_GAMMA: return gen_gamma(state);
         case RNG_WEIBULL: return gen_weibull(state);
         case RNG_POISSON: return gen_poisson(state);
+        case RNG_TRUNC_NORMAL: return gen_trunc_normal(state);
         default: return rng_next_double(state);
     }
 }
 
+// bulk loops run the engine on a local copy so its state stays in registers
+#define FILL_LOOP(type_t, field, step) do { \
+        type_t x = state->state.field; \
+        for (size_t i = 0; i < n; i++) { uint64_t v = step(&x); memcpy(out + 8 * i, &v, 8); } \
+        state->state.field = x; \
+    } while (0)
+
+// drain the block buffer, then encrypt whole groups straight into the output
+static void aes_fill(rng_state_t* state, uint8_t* out, size_t n) {
+    aes_ctr_t* x = &state->state.aes;
+    while (n && x->pos < 2 * AES_BUF_BLOCKS) {
+        memcpy(out, &x->buf[x->pos++], 8);
+        out += 8; n--;
+    }
+    size_t blocks = n / (2 * AES_BUF_BLOCKS) * AES_BUF_BLOCKS;
+    aes_ctr_blocks(x, out, blocks);
+    STAT_ADD(state, regenerations, blocks / AES_BUF_BLOCKS);
+    out += 16 * blocks; n -= 2 * blocks;
+    for (; n; n--, out += 8) {
+        uint64_t v = aes_next(state);
+        memcpy(out, &v, 8);
+    }
+}
+
+// whole blocks are claimed straight into the output, no staging copy
+static void service_fill(rng_state_t* state, uint8_t* out, size_t n) {
+    size_t bs = state->state.service.size;
+    while (n && state->state.service.pos + 8 <= bs) {
+        uint64_t v = service_next(state);
+        memcpy(out, &v, 8);
+        out += 8; n--;
+    }
+    for (; n >= bs / 8; n -= bs / 8, out += bs) service_block(state, out);
+    for (; n; n--, out += 8) {
+        uint64_t v = service_next(state);
+        memcpy(out, &v, 8);
+    }
+}
+
+static void fill_words(rng_state_t* state, uint8_t* out, size_t n) {
+    rng_state_t* base = dist_base(state);
+    if (base) {
+        fill_words(base, out, n);
+        return;
+    }
+    STAT_ADD(state, draws, n);
+    switch (state->type) {
+        case RNG_SERVICE: service_fill(state, out, n); break;
+        case RNG_AES128CTR:
+        case RNG_ARS5: aes_fill(state, out, n); break;
+        case RNG_XOSHIRO256PP: FILL_LOOP(xoshiro256_t, xoshiro256, xoshiro256pp_step); break;
+        case RNG_XOSHIRO256P: FILL_LOOP(xoshiro256_t, xoshiro256, xoshiro256p_step); break;
+        case RNG_XOROSHIRO128P: FILL_LOOP(xoroshiro128_t, xoroshiro128, xoroshiro128p_step); break;
+        case RNG_SFC64: FILL_LOOP(sfc64_t, sfc64, sfc64_step); break;
+        case RNG_WYRAND: FILL_LOOP(wyrand_t, wyrand, wyrand_step); break;
+        case RNG_ROMUTRIO: FILL_LOOP(romutrio_t, romutrio, romutrio_step); break;
+        case RNG_LFSR: FILL_LOOP(lfsr_t, lfsr, lfsr_step); break;
+        default:
+            for (size_t i = 0; i < n; i++) {
+                uint64_t v = engine_next_uint64(state);
+                memcpy(out + 8 * i, &v, 8);
+            }
+            break;
+    }
+}
+
+// words per fill/convert pass in rng_fill_double, 0 = whole request at once.
+// this and nt_threshold are tuning knobs that may change under running
+// fills, so they are read and written atomically; any value is correct.
+static size_t fill_chunk = 0;
+
+// same values as repeated rng_next_double
+static void fill_doubles(rng_state_t* state, double* out, size_t n) {
+    if (state->type == RNG_DSFMT) {
+        size_t left = (size_t)(DSFMT_N64 - state->state.dsfmt.idx);
+        STAT_ADD(state, draws, n);
+        STAT_ADD(state, regenerations, n > left ? (n - left + DSFMT_N64 - 1) / DSFMT_N64 : 0);
+        dsfmt_fill_close0_open1(&state->state.dsfmt, out, n);
+        return;
+    }
+    // words are converted in chunks so they are still in cache when read back
+    size_t chunk = __atomic_load_n(&fill_chunk, __ATOMIC_RELAXED);
+    if (!chunk) chunk = n;
+    for (size_t done = 0; done < n; done += chunk) {
+        size_t m = n - done < chunk ? n - done : chunk;
+        double* p = out + done;
+        fill_words(state, (uint8_t*)p, m);
+        for (size_t i = 0; i < m; i++) {
+            uint64_t x;
+            memcpy(&x, &p[i], 8);
+            p[i] = (double)(int64_t)(x >> 11) * (1.0/9007199254740992.0);
+        }
+    }
+}
+
+// fills of at least this many bytes bypass the cache, 0 = half the llc
+static size_t nt_threshold = 0;
+static size_t nt_default = 0;  // half the llc, looked up once
+
+void rng_set_nt_threshold(size_t bytes) {
+    __atomic_store_n(&nt_threshold, bytes, __ATOMIC_RELAXED);
+}
+
+size_t rng_nt_threshold(void) {
+    size_t d = __atomic_load_n(&nt_threshold, __ATOMIC_RELAXED);
+    if (d) return d;
+    d = __atomic_load_n(&nt_default, __ATOMIC_RELAXED);
+    if (d) return d;
+    long llc = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    d = llc > 0 ? (size_t)llc / 2 : (size_t)8 << 20;
+    __atomic_store_n(&nt_default, d, __ATOMIC_RELAXED);
+    return d;
+}
+
+#ifdef __SSE2__
+#define NT_STAGE 512  // 4 kb staging block, stays in l1
+
+// large fills: generate into the staging block exactly as the cached path
+// would, then stream it out with non-temporal stores. out must be 8-aligned
+// and n at least 2, so the alignment word never runs past the end.
+static void nt_fill(rng_state_t* state, uint8_t* out, size_t n, bool as_double) {
+    uint64_t stage[NT_STAGE] __attribute__((aligned(16)));
+    if ((uintptr_t)out & 15) {
+        if (as_double) fill_doubles(state, (double*)out, 1);
+        else fill_words(state, out, 1);
+        out += 8; n--;
+    }
+    while (n >= 2) {
+        size_t m = n < NT_STAGE ? n & ~(size_t)1 : NT_STAGE;
+        if (as_double) fill_doubles(state, (double*)stage, m);
+        else fill_words(state, (uint8_t*)stage, m);
+        for (size_t i = 0; i < m; i += 2)
+            _mm_stream_si128((__m128i*)(out + 8 * i), _mm_load_si128((const __m128i*)&stage[i]));
+        out += 8 * m; n -= m;
+    }
+    if (n) {
+        if (as_double) fill_doubles(state, (double*)out, 1);
+        else fill_words(state, out, 1);
+    }
+    _mm_sfence();
+}
+
+static bool use_nt(const void* out, size_t bytes) {
+    return ((uintptr_t)out & 7) == 0 && bytes >= 16 && bytes >= rng_nt_threshold();
+}
+#endif
+
 bool rng_fill_bytes(rng_state_t* state, void* buf, size_t size) {
     if (!state || !buf || !size) return 0;
     uint8_t* bytes = buf;
+    size_t i = size & ~(size_t)7;
+    STAT_ADD(state, bytes, size);
+#ifdef __SSE2__
+    if (use_nt(bytes, size)) nt_fill(state, bytes, size / 8, 0);
+    else
+#endif
+    fill_words(state, bytes, size / 8);
+    // a partial last word is the head of the next stream word, so a short
+    // fill is a prefix of a longer one
+    if (i < size) {
+        uint64_t v;
+        fill_words(state, (uint8_t*)&v, 1);
+        memcpy(bytes + i, &v, size - i);
+    }
+    return 1;
+}
+
+bool rng_fill_double(rng_state_t* state, double* out, size_t n) {
+    if (!state || !out || !n) return 0;
+    STAT_ADD(state, bytes, 8 * n);
+#ifdef __SSE2__
+    if (use_nt(out, 8 * n)) {
+        nt_fill(state, (uint8_t*)out, n, 1);
+        return 1;
+    }
+#endif
+    fill_doubles(state, out, n);
+    return 1;
+}
+
+void rng_set_fill_chunk(size_t words) {
+    __atomic_store_n(&fill_chunk, words, __ATOMIC_RELAXED);
+}
+
+size_t rng_fill_chunk(void) {
+    return __atomic_load_n(&fill_chunk, __ATOMIC_RELAXED);
+}
+
+// same values as repeated rng_next_distribution, with the type switch
+// hoisted out of the loop and gaussian pairs written straight to out
+static void fill_distribution(rng_state_t* state, double* out, size_t n) {
     size_t i = 0;
-    while (i + 8 <= size) {
-        uint64_t val = rng_next_uint64(state);
-        memcpy(bytes + i, &val, 8);
-        i += 8;
+    switch (state->type) {
+        case RNG_GAUSSIAN: {
+            double mean = state->params.gaussian.mean, sd = state->params.gaussian.stddev, z1;
+            STAT_ADD(state, samples, n);
+            if (state->state.gaussian.has_cache) {
+                state->state.gaussian.has_cache = 0;
+                STAT_ADD(state, cache_hits, 1);
+                out[i++] = state->state.gaussian.cache;
+            }
+            for (; i + 2 <= n; i += 2) {
+                out[i] = mean + sd * polar_pair(state, state->state.gaussian.base, &z1);
+                out[i + 1] = mean + sd * z1;
+            }
+            if (i < n) out[i] = gen_gaussian(state);
+            return;
+        }
+        case RNG_GAMMA:
+            STAT_ADD(state, samples, n);
+            for (; i < n; i++) out[i] = gen_gamma(state);
+            return;
+        case RNG_WEIBULL:
+            STAT_ADD(state, samples, n);
+            for (; i < n; i++) out[i] = gen_weibull(state);
+            return;
+        case RNG_POISSON:
+            STAT_ADD(state, samples, n);
+            for (; i < n; i++) out[i] = gen_poisson(state);
+            return;
+        case RNG_TRUNC_NORMAL:
+            STAT_ADD(state, samples, n);
+            fill_trunc_normal(state, out, n);
+            return;
+        default:
+            fill_doubles(state, out, n);
+            return;
     }
-    if (i < size) {
-        uint64_t val = rng_next_uint64(state);
-        memcpy(bytes + i, &val, size - i);
+}
+
+bool rng_fill_distribution(rng_state_t* state, double* out, size_t n) {
+    if (!state || !out || !n) return 0;
+    STAT_ADD(state, bytes, 8 * n);
+    fill_distribution(state, out, n);
+    return 1;
+}
+
+// generate-and-consume in l1-sized blocks from one buffer kept on the state,
+// so a long run needs neither a big array nor a call per value
+bool rng_stream_blocks(rng_state_t* state, rng_block_kind_t kind, size_t total_n, size_t block_n,
+                       rng_block_fn fn, void* ctx) {
+    if (!state || !fn || kind > RNG_BLOCK_DISTRIBUTION) return 0;
+    if (!block_n) block_n = RNG_BLOCK_DEFAULT;
+    if (block_n > total_n) block_n = total_n;
+    if (block_n > state->block_cap) {
+        void* mem = NULL;
+        if (posix_memalign(&mem, 64, block_n * 8)) return 0;
+        free(state->block);
+        state->block = mem;
+        state->block_cap = block_n;
+    }
+    for (size_t done = 0; done < total_n; done += block_n) {
+        size_t m = total_n - done < block_n ? total_n - done : block_n;
+        STAT_ADD(state, bytes, 8 * m);
+        switch (kind) {
+            case RNG_BLOCK_UINT64: fill_words(state, state->block, m); break;
+            case RNG_BLOCK_DOUBLE: fill_doubles(state, state->block, m); break;
+            case RNG_BLOCK_DISTRIBUTION: fill_distribution(state, state->block, m); break;
+        }
+        if (!fn(state->block, m, ctx)) return 0;
     }
     return 1;
 }
 
 bool rng_reseed(rng_state_t* state, uint64_t seed) {
     if (!state) return 0;
-    rng_state_t* new = rng_init(state->type, seed, &state->params);
-    if (!new) return 0;
+    state->res_bits = 0;
+    if (seed == 0 && state->type != RNG_LFSR) seed = (uint64_t)time(NULL);
     switch (state->type) {
-        case RNG_XOSHIRO256PP:
-            memcpy(state->state.xoshiro256pp.s, new->state.xoshiro256pp.s, sizeof(state->state.xoshiro256pp.s));
-            break;
-        case RNG_PCG32:
-            state->state.pcg32.state = new->state.pcg32.state;
-            state->state.pcg32.inc = new->state.pcg32.inc;
-            break;
-        case RNG_CHACHA20:
-            memcpy(state->state.chacha20.state, new->state.chacha20.state, sizeof(state->state.chacha20.state));
-            state->state.chacha20.pos = new->state.chacha20.pos;
-            break;
-        case RNG_MT19937:
-            memcpy(state->state.mt19937.state, new->state.mt19937.state, sizeof(state->state.mt19937.state));
-            state->state.mt19937.idx = new->state.mt19937.idx;
-            break;
         case RNG_GAUSSIAN:
             rng_reseed(state->state.gaussian.base, seed);
             state->state.gaussian.has_cache = 0;
-            break;
+            return 1;
         case RNG_GAMMA:
         case RNG_WEIBULL:
         case RNG_POISSON:
-            rng_reseed(state->state.other_dist.base, seed);
-            break;
+        case RNG_TRUNC_NORMAL:
+            state->state.other_dist.has_cache = 0;
+            return rng_reseed(state->state.other_dist.base, seed);
+        case RNG_SERVICE:
+            state->state.service.pos = state->state.service.size;
+            return rng_reseed(state->state.service.local, seed);
         default:
-            rng_free(new);
-            return 0;
+            return seed_engine(state, seed);
     }
-    rng_free(new);
-    return 1;
 }
 
 bool rng_analyze(rng_state_t* state, size_t sample_size, void* results) {
@@ -304,23 +1053,154 @@ bool rng_analyze(rng_state_t* state, size_t sample_size, void* results) {
     return 1; // placeholder, needs real stats
 }
 
+// jump polynomials advance 2^128 (xoshiro256) / 2^64 (xoroshiro128) steps,
+// counter engines skip 2^64 blocks and drop any buffered output, and the
+// bit reservoir is emptied.
+// sfc64, wyrand and romu have no cheap jump and return 0.
 bool rng_jump(rng_state_t* state) {
-    if (!state || state->type != RNG_XOSHIRO256PP) return 0;
-    static const uint64_t JUMP[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c,
-                                     0xa9582618e03fc9aa, 0x39abdc4529b1661c };
-    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
-    for (int i = 0; i < 4; i++) {
-        for (int b = 0; b < 64; b++) {
-            if (JUMP[i] & ((uint64_t)1 << b)) {
-                s0 ^= state->state.xoshiro256pp.s[0];
-                s1 ^= state->state.xoshiro256pp.s[1];
-                s2 ^= state->state.xoshiro256pp.s[2];
-                s3 ^= state->state.xoshiro256pp.s[3];
+    if (!state) return 0;
+    if (state->type == RNG_AES128CTR || state->type == RNG_ARS5) {
+        state->state.aes.ctr[1]++;
+        state->state.aes.pos = 2 * AES_BUF_BLOCKS;
+        state->res_bits = 0;
+        return 1;
+    }
+    if (state->type == RNG_XOSHIRO256PP || state->type == RNG_XOSHIRO256P) {
+        static const uint64_t JUMP[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c,
+                                         0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+        xoshiro256_t* x = &state->state.xoshiro256;
+        uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (int i = 0; i < 4; i++) {
+            for (int b = 0; b < 64; b++) {
+                if (JUMP[i] & ((uint64_t)1 << b)) {
+                    s0 ^= x->s[0]; s1 ^= x->s[1];
+                    s2 ^= x->s[2]; s3 ^= x->s[3];
+                }
+                xoshiro256_step(x);
+            }
+        }
+        x->s[0] = s0; x->s[1] = s1; x->s[2] = s2; x->s[3] = s3;
+        state->res_bits = 0;
+        return 1;
+    }
+    if (state->type == RNG_XOROSHIRO128P) {
+        static const uint64_t JUMP[] = { 0xdf900294d8f554a5, 0x170865df4b3201fc };
+        xoroshiro128_t* x = &state->state.xoroshiro128;
+        uint64_t s0 = 0, s1 = 0;
+        for (int i = 0; i < 2; i++) {
+            for (int b = 0; b < 64; b++) {
+                if (JUMP[i] & ((uint64_t)1 << b)) { s0 ^= x->s[0]; s1 ^= x->s[1]; }
+                xoroshiro128p_step(x);
             }
-            xoshiro256pp_next(state);
         }
+        x->s[0] = s0; x->s[1] = s1;
+        state->res_bits = 0;
+        return 1;
     }
-    state->state.xoshiro256pp.s[0] = s0; state->state.xoshiro256pp.s[1] = s1;
-    state->state.xoshiro256pp.s[2] = s2; state->state.xoshiro256pp.s[3] = s3;
+    return 0;
+}
+
+// keyed random access: the (seed, key) pair picks a stream, index is a counter.
+// two splitmix rounds keyed by independent words keep distinct streams from
+// being shifted copies of one weyl sequence.
+static inline void hash_stream(uint64_t seed, uint64_t key, uint64_t* k0, uint64_t* k1) {
+    *k0 = mix64(seed ^ mix64(key + GOLDEN_GAMMA));
+    *k1 = mix64(seed + mix64(key ^ 0xd1b54a32d192ed03ULL));
+}
+
+static inline uint64_t hash_block(uint64_t k0, uint64_t k1, uint64_t index) {
+    return mix64(mix64(index * GOLDEN_GAMMA + k0) ^ k1);
+}
+
+uint64_t rng_hash_key(uint64_t key, uint64_t sub) {
+    return mix64(key ^ mix64(sub + 0x8cb92ba72f3d8dd7ULL));
+}
+
+uint64_t rng_hash_at(uint64_t seed, uint64_t key, uint64_t index) {
+    uint64_t k0, k1;
+    hash_stream(seed, key, &k0, &k1);
+    return hash_block(k0, k1, index);
+}
+
+void rng_hash_fill(uint64_t seed, uint64_t key, uint64_t first_index, size_t n, uint64_t* out) {
+    if (!out) return;
+    uint64_t k0, k1;
+    hash_stream(seed, key, &k0, &k1);
+    // no loop-carried state, so the compiler is free to unroll and vectorize
+    for (size_t i = 0; i < n; i++) out[i] = hash_block(k0, k1, first_index + i);
+}
+
+bool rng_lfsr_jump(rng_state_t* state, uint64_t nbits) {
+    if (!state || state->type != RNG_LFSR) return 0;
+    lfsr_jump(&state->state.lfsr, nbits);
+    state->res_bits = 0;
     return 1;
 }
+
+uint64_t rng_prbs_check(uint64_t poly, const void* data, size_t nbits) {
+    return lfsr_check(poly, data, nbits);
+}
+
+bool rng_has_aesni(void) {
+    return aes_hw_available();
+}
+
+// client of an rngd ring; falls back to a local engine of type fallback
+rng_state_t* rng_service_connect(const char* name, rng_type_t fallback, uint64_t seed) {
+    rng_state_t* state = state_alloc();
+    if (!state) return NULL;
+    state->type = RNG_SERVICE;
+    state->state.service.local = rng_init(fallback, seed, NULL);
+    if (!state->state.service.local) {
+        free(state);
+        return NULL;
+    }
+    if (!name || !svc_client_open(&state->state.service.client, name))
+        state->state.service.client.block_size = 4096;
+    state->state.service.size = state->state.service.client.block_size;
+    state->state.service.pos = state->state.service.size;
+    state->state.service.buf = malloc(state->state.service.size);
+    if (!state->state.service.buf) {
+        rng_free(state);
+        return NULL;
+    }
+    return state;
+}
+
+bool rng_service_counts(rng_state_t* state, uint64_t* served, uint64_t* local) {
+    if (!state || state->type != RNG_SERVICE) return 0;
+    if (served) *served = state->state.service.served;
+    if (local) *local = state->state.service.fallback;
+    return 1;
+}
+
+// sampler counters of a distribution state are reported together with the
+// engine counters of its base
+bool rng_stats(rng_state_t* state, rng_stats_t* out) {
+    if (!out) return 0;
+    memset(out, 0, sizeof(*out));
+#ifdef RNG_STATS
+    if (!state) return 0;
+    *out = state->stats;
+    rng_state_t* base = dist_base(state);
+    if (base) {
+        out->draws += base->stats.draws;
+        out->bytes += base->stats.bytes;
+        out->regenerations += base->stats.regenerations;
+    }
+    return 1;
+#else
+    (void)state;
+    return 0;
+#endif
+}
+
+void rng_stats_reset(rng_state_t* state) {
+#ifdef RNG_STATS
+    if (!state) return;
+    memset(&state->stats, 0, sizeof(state->stats));
+    if (dist_base(state)) rng_stats_reset(dist_base(state));
+#else
+    (void)state;
+#endif
+}
@@ -0,0 +1,244 @@
+#include "rng_aes.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AES_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+static const uint8_t SBOX[256] = {
+    0x63,0x7c,0x77,0x7b,0xf2,0x6b,0x6f,0xc5,0x30,0x01,0x67,0x2b,0xfe,0xd7,0xab,0x76,
+    0xca,0x82,0xc9,0x7d,0xfa,0x59,0x47,0xf0,0xad,0xd4,0xa2,0xaf,0x9c,0xa4,0x72,0xc0,
+    0xb7,0xfd,0x93,0x26,0x36,0x3f,0xf7,0xcc,0x34,0xa5,0xe5,0xf1,0x71,0xd8,0x31,0x15,
+    0x04,0xc7,0x23,0xc3,0x18,0x96,0x05,0x9a,0x07,0x12,0x80,0xe2,0xeb,0x27,0xb2,0x75,
+    0x09,0x83,0x2c,0x1a,0x1b,0x6e,0x5a,0xa0,0x52,0x3b,0xd6,0xb3,0x29,0xe3,0x2f,0x84,
+    0x53,0xd1,0x00,0xed,0x20,0xfc,0xb1,0x5b,0x6a,0xcb,0xbe,0x39,0x4a,0x4c,0x58,0xcf,
+    0xd0,0xef,0xaa,0xfb,0x43,0x4d,0x33,0x85,0x45,0xf9,0x02,0x7f,0x50,0x3c,0x9f,0xa8,
+    0x51,0xa3,0x40,0x8f,0x92,0x9d,0x38,0xf5,0xbc,0xb6,0xda,0x21,0x10,0xff,0xf3,0xd2,
+    0xcd,0x0c,0x13,0xec,0x5f,0x97,0x44,0x17,0xc4,0xa7,0x7e,0x3d,0x64,0x5d,0x19,0x73,
+    0x60,0x81,0x4f,0xdc,0x22,0x2a,0x90,0x88,0x46,0xee,0xb8,0x14,0xde,0x5e,0x0b,0xdb,
+    0xe0,0x32,0x3a,0x0a,0x49,0x06,0x24,0x5c,0xc2,0xd3,0xac,0x62,0x91,0x95,0xe4,0x79,
+    0xe7,0xc8,0x37,0x6d,0x8d,0xd5,0x4e,0xa9,0x6c,0x56,0xf4,0xea,0x65,0x7a,0xae,0x08,
+    0xba,0x78,0x25,0x2e,0x1c,0xa6,0xb4,0xc6,0xe8,0xdd,0x74,0x1f,0x4b,0xbd,0x8b,0x8a,
+    0x70,0x3e,0xb5,0x66,0x48,0x03,0xf6,0x0e,0x61,0x35,0x57,0xb9,0x86,0xc1,0x1d,0x9e,
+    0xe1,0xf8,0x98,0x11,0x69,0xd9,0x8e,0x94,0x9b,0x1e,0x87,0xe9,0xce,0x55,0x28,0xdf,
+    0x8c,0xa1,0x89,0x0d,0xbf,0xe6,0x42,0x68,0x41,0x99,0x2d,0x0f,0xb0,0x54,0xbb,0x16
+};
+
+static inline uint8_t xtime(uint8_t b) {
+    return (uint8_t)((b << 1) ^ ((b >> 7) * 0x1b));
+}
+
+// one round with aesenc/aesenclast semantics: shiftrows, subbytes,
+// mixcolumns (unless last), then xor round key. state is column-major.
+static void soft_round(uint8_t s[16], const uint8_t rk[16], int last) {
+    uint8_t t[16];
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            t[4 * c + r] = SBOX[s[4 * ((c + r) & 3) + r]];
+    if (!last) {
+        for (int c = 0; c < 4; c++) {
+            uint8_t* col = t + 4 * c;
+            uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3], all = a0 ^ a1 ^ a2 ^ a3;
+            col[0] ^= all ^ xtime(a0 ^ a1);
+            col[1] ^= all ^ xtime(a1 ^ a2);
+            col[2] ^= all ^ xtime(a2 ^ a3);
+            col[3] ^= all ^ xtime(a3 ^ a0);
+        }
+    }
+    for (int i = 0; i < 16; i++) s[i] = t[i] ^ rk[i];
+}
+
+static void ctr_block(const aes_ctr_t* x, uint64_t lo, uint64_t hi, uint8_t b[16]) {
+    for (int i = 0; i < 8; i++) {
+        b[i] = (uint8_t)(lo >> (8 * i));
+        b[8 + i] = (uint8_t)(hi >> (8 * i));
+    }
+    for (int i = 0; i < 16; i++) b[i] ^= x->rk[0][i];
+}
+
+static void soft_blocks(const aes_ctr_t* x, uint64_t lo, uint64_t hi, uint8_t* out, size_t n) {
+    for (size_t j = 0; j < n; j++) {
+        uint8_t b[16];
+        ctr_block(x, lo, hi, b);
+        for (uint32_t r = 1; r < x->rounds; r++) soft_round(b, x->rk[r], 0);
+        soft_round(b, x->rk[x->rounds], 1);
+        memcpy(out + 16 * j, b, 16);
+        if (++lo == 0) hi++;
+    }
+}
+
+#ifdef AES_X86
+#define AES_ROUND8(f, k) do { \
+        v0 = f(v0, k); v1 = f(v1, k); v2 = f(v2, k); v3 = f(v3, k); \
+        v4 = f(v4, k); v5 = f(v5, k); v6 = f(v6, k); v7 = f(v7, k); \
+    } while (0)
+
+// eight independent blocks in flight hide the aesenc latency; the round
+// count is a compile-time constant so the key schedule stays in registers
+#define HW_BLOCKS(name, ROUNDS) \
+__attribute__((target("aes,sse2"))) \
+static void name(const aes_ctr_t* x, uint64_t lo, uint64_t hi, uint8_t* out, size_t n) { \
+    __m128i rk[ROUNDS + 1]; \
+    for (int r = 0; r <= ROUNDS; r++) rk[r] = _mm_loadu_si128((const __m128i*)x->rk[r]); \
+    __m128i* dst = (__m128i*)out; \
+    size_t j = 0; \
+    for (; j + 8 <= n; j += 8) { \
+        __m128i c[8]; \
+        for (int k = 0; k < 8; k++) { \
+            uint64_t l = lo + k, h = hi + (l < lo); \
+            c[k] = _mm_xor_si128(_mm_set_epi64x((long long)h, (long long)l), rk[0]); \
+        } \
+        __m128i v0 = c[0], v1 = c[1], v2 = c[2], v3 = c[3], v4 = c[4], v5 = c[5], v6 = c[6], v7 = c[7]; \
+        for (int r = 1; r < ROUNDS; r++) AES_ROUND8(_mm_aesenc_si128, rk[r]); \
+        AES_ROUND8(_mm_aesenclast_si128, rk[ROUNDS]); \
+        _mm_storeu_si128(dst + j, v0); _mm_storeu_si128(dst + j + 1, v1); \
+        _mm_storeu_si128(dst + j + 2, v2); _mm_storeu_si128(dst + j + 3, v3); \
+        _mm_storeu_si128(dst + j + 4, v4); _mm_storeu_si128(dst + j + 5, v5); \
+        _mm_storeu_si128(dst + j + 6, v6); _mm_storeu_si128(dst + j + 7, v7); \
+        lo += 8; if (lo < 8) hi++; \
+    } \
+    for (; j < n; j++) { \
+        __m128i v = _mm_xor_si128(_mm_set_epi64x((long long)hi, (long long)lo), rk[0]); \
+        for (int r = 1; r < ROUNDS; r++) v = _mm_aesenc_si128(v, rk[r]); \
+        _mm_storeu_si128(dst + j, _mm_aesenclast_si128(v, rk[ROUNDS])); \
+        if (++lo == 0) hi++; \
+    } \
+}
+
+HW_BLOCKS(hw_blocks_aes, 10)
+HW_BLOCKS(hw_blocks_ars, 5)
+
+// vaes: four blocks per zmm, four zmm in flight. only used when the low
+// counter word cannot wrap inside the request, so lanes add without carry.
+#define VAES_BLOCKS(name, ROUNDS) \
+__attribute__((target("vaes,avx512f"))) \
+static void name(const aes_ctr_t* x, uint64_t lo, uint64_t hi, uint8_t* out, size_t n) { \
+    __m512i rk[ROUNDS + 1]; \
+    for (int r = 0; r <= ROUNDS; r++) \
+        rk[r] = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)x->rk[r])); \
+    __m512i ctr = _mm512_set_epi64((long long)hi, (long long)(lo + 3), (long long)hi, (long long)(lo + 2), \
+                                   (long long)hi, (long long)(lo + 1), (long long)hi, (long long)lo); \
+    const __m512i inc = _mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4); \
+    size_t j = 0; \
+    for (; j + 16 <= n; j += 16) { \
+        __m512i a = _mm512_xor_si512(ctr, rk[0]); ctr = _mm512_add_epi64(ctr, inc); \
+        __m512i b = _mm512_xor_si512(ctr, rk[0]); ctr = _mm512_add_epi64(ctr, inc); \
+        __m512i c = _mm512_xor_si512(ctr, rk[0]); ctr = _mm512_add_epi64(ctr, inc); \
+        __m512i d = _mm512_xor_si512(ctr, rk[0]); ctr = _mm512_add_epi64(ctr, inc); \
+        for (int r = 1; r < ROUNDS; r++) { \
+            a = _mm512_aesenc_epi128(a, rk[r]); b = _mm512_aesenc_epi128(b, rk[r]); \
+            c = _mm512_aesenc_epi128(c, rk[r]); d = _mm512_aesenc_epi128(d, rk[r]); \
+        } \
+        _mm512_storeu_si512(out + 16 * j, _mm512_aesenclast_epi128(a, rk[ROUNDS])); \
+        _mm512_storeu_si512(out + 16 * j + 64, _mm512_aesenclast_epi128(b, rk[ROUNDS])); \
+        _mm512_storeu_si512(out + 16 * j + 128, _mm512_aesenclast_epi128(c, rk[ROUNDS])); \
+        _mm512_storeu_si512(out + 16 * j + 192, _mm512_aesenclast_epi128(d, rk[ROUNDS])); \
+    } \
+    if (j < n) HW_TAIL_##ROUNDS(x, lo + j, hi, out + 16 * j, n - j); \
+}
+
+#define HW_TAIL_10 hw_blocks_aes
+#define HW_TAIL_5 hw_blocks_ars
+VAES_BLOCKS(vaes_blocks_aes, 10)
+VAES_BLOCKS(vaes_blocks_ars, 5)
+
+static uint64_t xgetbv0(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+}
+#endif
+
+// 0 = portable, 1 = aes-ni, 2 = vaes with avx-512 state enabled by the os.
+// detected once; pthread_once makes concurrent first calls safe.
+static int hw_level = 0;
+static pthread_once_t hw_once = PTHREAD_ONCE_INIT;
+
+static void hw_detect(void) {
+#ifdef AES_X86
+    unsigned a, b, c, d;
+    if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_AES) && (d & bit_SSE2)) {
+        hw_level = 1;
+        int osxsave = (c & bit_OSXSAVE) != 0;
+        if (osxsave && __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_AVX512F) &&
+            (c & bit_VAES) && (xgetbv0() & 0xe6) == 0xe6)
+            hw_level = 2;
+    }
+#endif
+}
+
+int aes_hw_available(void) {
+    pthread_once(&hw_once, hw_detect);
+    return hw_level;
+}
+
+// upper bound on the kernel aes_ctr_blocks may pick, set by the autotuner.
+// every kernel produces the same blocks, so this only affects speed; atomic
+// since the tuner may set it while other threads generate.
+static int aes_kernel = 2;
+
+void aes_set_kernel(int level) {
+    __atomic_store_n(&aes_kernel, level < 0 ? 0 : level, __ATOMIC_RELAXED);
+}
+
+int aes_kernel_level(void) {
+    int hw = aes_hw_available(), cap = __atomic_load_n(&aes_kernel, __ATOMIC_RELAXED);
+    return hw < cap ? hw : cap;
+}
+
+static void aes128_expand(uint8_t rk[11][16], const uint8_t key[16]) {
+    uint8_t rcon = 1;
+    memcpy(rk[0], key, 16);
+    for (int r = 1; r <= 10; r++) {
+        const uint8_t* p = rk[r - 1];
+        uint8_t t[4] = { SBOX[p[13]], SBOX[p[14]], SBOX[p[15]], SBOX[p[12]] };
+        t[0] ^= rcon; rcon = xtime(rcon);
+        for (int i = 0; i < 4; i++) rk[r][i] = p[i] ^ t[i];
+        for (int i = 4; i < 16; i++) rk[r][i] = p[i] ^ rk[r][i - 4];
+    }
+}
+
+void aes_ctr_seed(aes_ctr_t* x, uint64_t k0, uint64_t k1, int ars) {
+    uint8_t key[16];
+    for (int i = 0; i < 8; i++) {
+        key[i] = (uint8_t)(k0 >> (8 * i));
+        key[8 + i] = (uint8_t)(k1 >> (8 * i));
+    }
+    memset(x, 0, sizeof(*x));
+    if (ars) {
+        // ars-5: the round key is bumped by a 64x2 weyl step each round
+        x->rounds = 5;
+        for (int r = 0; r <= 5; r++) {
+            for (int i = 0; i < 8; i++) {
+                x->rk[r][i] = (uint8_t)(k0 >> (8 * i));
+                x->rk[r][8 + i] = (uint8_t)(k1 >> (8 * i));
+            }
+            k0 += 0x9e3779b97f4a7c15ULL;
+            k1 += 0xbb67ae8584caa73bULL;
+        }
+    } else {
+        x->rounds = 10;
+        aes128_expand(x->rk, key);
+    }
+    x->pos = 2 * AES_BUF_BLOCKS;
+}
+
+void aes_ctr_blocks(aes_ctr_t* x, uint8_t* out, size_t nblocks) {
+#ifdef AES_X86
+    int hw = aes_kernel_level();
+    if (hw == 2 && nblocks >= 16 && x->ctr[0] + nblocks >= x->ctr[0]) {
+        if (x->rounds == 10) vaes_blocks_aes(x, x->ctr[0], x->ctr[1], out, nblocks);
+        else vaes_blocks_ars(x, x->ctr[0], x->ctr[1], out, nblocks);
+    } else if (hw) {
+        if (x->rounds == 10) hw_blocks_aes(x, x->ctr[0], x->ctr[1], out, nblocks);
+        else hw_blocks_ars(x, x->ctr[0], x->ctr[1], out, nblocks);
+    } else
+#endif
+    soft_blocks(x, x->ctr[0], x->ctr[1], out, nblocks);
+    uint64_t lo = x->ctr[0] + nblocks;
+    if (lo < x->ctr[0]) x->ctr[1]++;
+    x->ctr[0] = lo;
+}
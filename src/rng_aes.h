@@ -0,0 +1,25 @@
+#ifndef RNG_AES_H
+#define RNG_AES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// internal: aes-128 counter mode and ars-5 block engines used by rng.c
+
+#define AES_BUF_BLOCKS 8
+
+typedef struct {
+    uint8_t rk[11][16];              // aes-128 round keys, or ars-5 keys in rk[0..5]
+    uint64_t ctr[2];                 // next block counter, little-endian 128-bit
+    uint64_t buf[2 * AES_BUF_BLOCKS];
+    uint32_t pos;
+    uint32_t rounds;                 // 10 for aes-128, 5 for ars-5
+} aes_ctr_t;
+
+void aes_ctr_seed(aes_ctr_t* x, uint64_t k0, uint64_t k1, int ars);
+void aes_ctr_blocks(aes_ctr_t* x, uint8_t* out, size_t nblocks);
+int aes_hw_available(void);
+void aes_set_kernel(int level);  // cap on the kernel used: 0 portable, 1 aes-ni, 2 vaes
+int aes_kernel_level(void);      // kernel actually in use
+
+#endif
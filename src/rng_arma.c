@@ -0,0 +1,291 @@
+#include "rng.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARMA_KEY 0x61726d61ULL  // "arma"
+#define ARMA_BLOCK 4096         // steps per block, the unit of the parallel scan
+#define LYAP_ITERS 64
+
+// x_t = sum phi_i x_{t-i} + e_t + sum theta_j e_{t-j} in harvey's state
+// space form, r = max(p, q + 1):
+//   a_{t+1} = T a_t + R e_{t+1},  x_t = a_t[0]
+// T has phi down its first column and ones on the superdiagonal, R is
+// (1, theta_1, ..., theta_{r-1}). every series keeps its state between
+// calls; states are struct-of-arrays, a[i * series + s].
+struct rng_arma {
+    size_t r, series;
+    double* phi;           // r, zero padded
+    double* rr;            // R
+    double* tb;            // T^ARMA_BLOCK, r x r
+    double* chol;          // cholesky factor of the stationary covariance
+    double* state;         // r * series
+    double sigma, variance;
+    uint64_t seed, calls;
+};
+
+static void mat_mul(double* c, const double* a, const double* b, size_t r) {
+    for (size_t i = 0; i < r; i++)
+        for (size_t j = 0; j < r; j++) {
+            double s = 0.0;
+            for (size_t k = 0; k < r; k++) s += a[i * r + k] * b[k * r + j];
+            c[i * r + j] = s;
+        }
+}
+
+// stationary covariance P = T P T' + sigma^2 R R' by doubling:
+// P <- P + A P A', A <- A^2, so 64 rounds cover 2^64 steps. 0 when the
+// powers of T do not die out (a unit or explosive root); that is checked on
+// A itself, since P stays 0 and looks converged when sigma is 0.
+static bool lyapunov(const rng_arma_t* a, double sigma, double* p) {
+    size_t r = a->r;
+    double* m = malloc(4 * r * r * sizeof(double));
+    if (!m) return 0;
+    double *t = m, *tmp = m + r * r, *tmp2 = m + 2 * r * r, *t2 = m + 3 * r * r;
+    memset(t, 0, r * r * sizeof(double));
+    for (size_t i = 0; i < r; i++) {
+        t[i * r] = a->phi[i];
+        if (i + 1 < r) t[i * r + i + 1] = 1.0;
+        for (size_t j = 0; j < r; j++) p[i * r + j] = sigma * sigma * a->rr[i] * a->rr[j];
+    }
+    bool done = 0;
+    for (int it = 0; it < LYAP_ITERS && !done; it++) {
+        mat_mul(tmp, t, p, r);
+        for (size_t i = 0; i < r; i++)
+            for (size_t j = 0; j < r; j++) {
+                double s = 0.0;
+                for (size_t k = 0; k < r; k++) s += tmp[i * r + k] * t[j * r + k];
+                tmp2[i * r + j] = s;
+            }
+        double norm = 0.0, pn = 0.0, tn = 0.0;
+        for (size_t i = 0; i < r * r; i++) {
+            p[i] += tmp2[i];
+            norm = fmax(norm, fabs(tmp2[i]));
+            pn = fmax(pn, fabs(p[i]));
+            tn += fabs(t[i]);  // a sum, so a nan from inf * 0 is kept
+        }
+        done = norm <= 1e-17 * pn && tn <= 1e-9;
+        mat_mul(t2, t, t, r);
+        memcpy(t, t2, r * r * sizeof(double));
+    }
+    free(m);
+    return done;
+}
+
+// lower cholesky, pivots clamped at 0 so a semidefinite P still works
+static void cholesky(const double* p, double* l, size_t r) {
+    memset(l, 0, r * r * sizeof(double));
+    for (size_t j = 0; j < r; j++) {
+        double d = p[j * r + j];
+        for (size_t k = 0; k < j; k++) d -= l[j * r + k] * l[j * r + k];
+        d = d > 0.0 ? sqrt(d) : 0.0;
+        l[j * r + j] = d;
+        for (size_t i = j + 1; i < r; i++) {
+            double s = p[i * r + j];
+            for (size_t k = 0; k < j; k++) s -= l[i * r + k] * l[j * r + k];
+            l[i * r + j] = d > 0.0 ? s / d : 0.0;
+        }
+    }
+}
+
+void rng_arma_free(rng_arma_t* a) {
+    if (!a) return;
+    free(a->phi);
+    free(a->rr);
+    free(a->tb);
+    free(a->chol);
+    free(a->state);
+    free(a);
+}
+
+rng_arma_t* rng_arma_create(size_t p, const double* phi, size_t q, const double* theta,
+                            double sigma, size_t series, uint64_t seed) {
+    if (!series || (p && !phi) || (q && !theta) || !(sigma >= 0.0)) return NULL;
+    rng_arma_t* a = calloc(1, sizeof(rng_arma_t));
+    if (!a) return NULL;
+    size_t r = p > q + 1 ? p : q + 1;
+    a->r = r;
+    a->series = series;
+    a->sigma = sigma;
+    a->phi = calloc(r, sizeof(double));
+    a->rr = calloc(r, sizeof(double));
+    a->tb = calloc(r * r, sizeof(double));
+    a->chol = malloc(r * r * sizeof(double));
+    a->state = malloc(r * series * sizeof(double));
+    double* pm = malloc(r * r * sizeof(double));
+    double* t = calloc(r * r, sizeof(double));
+    double* t2 = malloc(r * r * sizeof(double));
+    bool ok = a->phi && a->rr && a->tb && a->chol && a->state && pm && t && t2;
+    if (ok) {
+        for (size_t i = 0; i < p; i++) a->phi[i] = phi[i];
+        a->rr[0] = 1.0;
+        for (size_t j = 0; j < q; j++) a->rr[j + 1] = theta[j];
+        ok = lyapunov(a, sigma, pm);
+    }
+    if (ok) {
+        a->variance = pm[0];
+        cholesky(pm, a->chol, r);
+        // T^ARMA_BLOCK by squaring, carries a state across a whole block
+        for (size_t i = 0; i < r; i++) {
+            t[i * r] = a->phi[i];
+            if (i + 1 < r) t[i * r + i + 1] = 1.0;
+            a->tb[i * r + i] = 1.0;
+        }
+        for (size_t e = ARMA_BLOCK; e; e >>= 1) {
+            if (e & 1) {
+                mat_mul(t2, a->tb, t, r);
+                memcpy(a->tb, t2, r * r * sizeof(double));
+            }
+            mat_mul(t2, t, t, r);
+            memcpy(t, t2, r * r * sizeof(double));
+        }
+        ok = rng_arma_reset(a, seed);
+    }
+    free(pm);
+    free(t);
+    free(t2);
+    if (!ok) {
+        rng_arma_free(a);
+        return NULL;
+    }
+    return a;
+}
+
+// fresh stationary start a_0 = L z for every series, no burn-in needed
+bool rng_arma_reset(rng_arma_t* a, uint64_t seed) {
+    if (!a) return 0;
+    const size_t r = a->r, n = a->series;
+    rng_params_t gp = { .gaussian = {0.0, 1.0} };
+    rng_state_t* g = rng_init(RNG_GAUSSIAN, rng_hash_key(seed, ARMA_KEY) | 1, &gp);
+    double* z = malloc(r * n * sizeof(double));
+    if (!g || !z) {
+        rng_free(g);
+        free(z);
+        return 0;
+    }
+    rng_fill_distribution(g, z, r * n);
+    for (size_t i = 0; i < r; i++)
+        for (size_t s = 0; s < n; s++) {
+            double v = 0.0;
+            for (size_t k = 0; k <= i; k++) v += a->chol[i * r + k] * z[k * n + s];
+            a->state[i * n + s] = v;
+        }
+    rng_free(g);
+    free(z);
+    a->seed = seed;
+    a->calls = 0;
+    return 1;
+}
+
+double rng_arma_variance(const rng_arma_t* a) {
+    return a ? a->variance : 0.0;
+}
+
+// one step for every series: a <- T a + R e, then out = a[0] (or += with
+// e NULL). in place is safe because row i only reads row i + 1, which is
+// still old, and e may alias out since it is read first.
+static inline void arma_step(const rng_arma_t* a, double* st, double* a0, const double* e, double* out) {
+    const size_t r = a->r, n = a->series;
+    memcpy(a0, st, n * sizeof(double));
+    for (size_t i = 0; i < r; i++) {
+        double* row = st + i * n;
+        const double* next = i + 1 < r ? st + (i + 1) * n : NULL;
+        double ph = a->phi[i], rr = a->rr[i];
+        if (e && next) for (size_t s = 0; s < n; s++) row[s] = ph * a0[s] + next[s] + rr * e[s];
+        else if (e) for (size_t s = 0; s < n; s++) row[s] = ph * a0[s] + rr * e[s];
+        else if (next) for (size_t s = 0; s < n; s++) row[s] = ph * a0[s] + next[s];
+        else for (size_t s = 0; s < n; s++) row[s] = ph * a0[s];
+    }
+    if (e) memcpy(out, st, n * sizeof(double));
+    else for (size_t s = 0; s < n; s++) out[s] += st[s];
+}
+
+// a single series has nothing to vectorize across, so its m steps run as
+// a plain scalar loop; noise in out is replaced, otherwise out is added to
+static void arma_run1(const rng_arma_t* a, double* st, double* out, size_t m, bool noise) {
+    const size_t r = a->r;
+    const double* phi = a->phi;
+    const double* rr = a->rr;
+    for (size_t t = 0; t < m; t++) {
+        double a0 = st[0], e = noise ? out[t] : 0.0;
+        for (size_t i = 0; i + 1 < r; i++) st[i] = phi[i] * a0 + st[i + 1] + rr[i] * e;
+        st[r - 1] = phi[r - 1] * a0 + rr[r - 1] * e;
+        out[t] = noise ? st[0] : out[t] + st[0];
+    }
+}
+
+typedef struct {
+    rng_arma_t* a;
+    double* out;
+    size_t len, blocks;
+    double* zero_end;      // per block: end state when started from 0
+    double* start;         // per block: true start state
+    int pass;
+    bool failed;
+} arma_job_t;
+
+// block-parallel recursion: the recurrence is linear, so a block's output
+// is its response from a zero state (pass 0, parallel) plus the free
+// response T^k s of its true start state s (pass 1, parallel). the start
+// states are chained serially in between, s_{b+1} = T^B s_b + zero_end_b.
+static void arma_task(rng_state_t* rng, size_t b, void* ctx) {
+    arma_job_t* job = ctx;
+    rng_arma_t* a = job->a;
+    const size_t r = a->r, n = a->series;
+    size_t t0 = b * ARMA_BLOCK, m = job->len - t0 < ARMA_BLOCK ? job->len - t0 : ARMA_BLOCK;
+    double* st = (job->pass ? job->start : job->zero_end) + b * r * n;
+    double* a0 = malloc(n * sizeof(double));
+    if (!a0) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    double* out = job->out + t0 * n;
+    if (job->pass == 0) {
+        // the noise is drawn into out and replaced step by step
+        rng_fill_distribution(rng, out, m * n);
+        memset(st, 0, r * n * sizeof(double));
+        if (n == 1) arma_run1(a, st, out, m, 1);
+        else for (size_t t = 0; t < m; t++) arma_step(a, st, a0, out + t * n, out + t * n);
+    } else {
+        if (n == 1) arma_run1(a, st, out, m, 0);
+        else for (size_t t = 0; t < m; t++) arma_step(a, st, a0, NULL, out + t * n);
+        if (b + 1 == job->blocks) {
+            const double* z = job->zero_end + b * r * n;
+            for (size_t i = 0; i < r * n; i++) a->state[i] = st[i] + z[i];
+        }
+    }
+    free(a0);
+}
+
+// out is len * series, sample t of series s at out[t * series + s]; the
+// series continue from the previous call. blocks of 4096 steps draw from
+// keyed task streams, so results do not depend on num_threads.
+bool rng_arma_generate(rng_arma_t* a, double* out, size_t len, int num_threads) {
+    if (!a || !out) return 0;
+    if (!len) return 1;
+    const size_t r = a->r, n = a->series, blocks = (len + ARMA_BLOCK - 1) / ARMA_BLOCK;
+    arma_job_t job = { a, out, len, blocks, malloc(2 * blocks * r * n * sizeof(double)), NULL, 0, 0 };
+    if (!job.zero_end) return 0;
+    job.start = job.zero_end + blocks * r * n;
+    rng_params_t gp = { .gaussian = {0.0, a->sigma} };  // the innovations e
+    uint64_t seed = rng_hash_key(rng_hash_key(a->seed, ARMA_KEY), ++a->calls);
+    bool ok = rng_run_tasks(RNG_GAUSSIAN, seed, &gp, blocks, num_threads, arma_task, &job);
+    memcpy(job.start, a->state, r * n * sizeof(double));
+    for (size_t b = 0; ok && b + 1 < blocks; b++) {
+        const double* s = job.start + b * r * n;
+        const double* z = job.zero_end + b * r * n;
+        double* next = job.start + (b + 1) * r * n;
+        for (size_t i = 0; i < r; i++) {
+            memcpy(next + i * n, z + i * n, n * sizeof(double));
+            for (size_t k = 0; k < r; k++) {
+                double c = a->tb[i * r + k];
+                if (c != 0.0) for (size_t x = 0; x < n; x++) next[i * n + x] += c * s[k * n + x];
+            }
+        }
+    }
+    job.pass = 1;
+    ok = ok && rng_run_tasks(RNG_XOSHIRO256PP, 1, NULL, blocks, num_threads, arma_task, &job);
+    ok = ok && !job.failed;
+    free(job.zero_end);
+    return ok;
+}
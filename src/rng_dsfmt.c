@@ -0,0 +1,128 @@
+#include "rng_dsfmt.h"
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// dsfmt-19937 parameters (saito & matsumoto)
+#define DSFMT_POS1 117
+#define DSFMT_SL1 19
+#define DSFMT_SR 12
+#define DSFMT_MSK1 0x000ffafffffffb3fULL
+#define DSFMT_MSK2 0x000ffdfffc90fffdULL
+#define DSFMT_FIX1 0x90014964b32f4329ULL
+#define DSFMT_FIX2 0x3b8d12ac548a7c7aULL
+#define DSFMT_PCV1 0x3d84e1ac0dc82880ULL
+#define DSFMT_PCV2 0x0000000000000001ULL
+#define DSFMT_LOW_MASK 0x000fffffffffffffULL
+#define DSFMT_HIGH_CONST 0x3ff0000000000000ULL
+
+// the sse2 and scalar recursions give bit-identical output; dsfmt_kernel
+// picks between them and is only ever changed by the autotuner, which may
+// run while other threads generate, hence the atomic accesses
+#ifdef __SSE2__
+static int dsfmt_kernel = 1;
+
+static inline void recursion_sse2(dsfmt_w128_t* r, const dsfmt_w128_t* a, const dsfmt_w128_t* b, __m128i* lung) {
+    const __m128i mask = _mm_set_epi64x((long long)DSFMT_MSK2, (long long)DSFMT_MSK1);
+    __m128i x = _mm_loadu_si128((const __m128i*)a);
+    __m128i z = _mm_slli_epi64(x, DSFMT_SL1);
+    __m128i y = _mm_shuffle_epi32(*lung, 0x1b);
+    z = _mm_xor_si128(z, _mm_loadu_si128((const __m128i*)b));
+    y = _mm_xor_si128(y, z);
+    __m128i v = _mm_srli_epi64(y, DSFMT_SR);
+    __m128i w = _mm_and_si128(y, mask);
+    v = _mm_xor_si128(v, x);
+    v = _mm_xor_si128(v, w);
+    _mm_storeu_si128((__m128i*)r, v);
+    *lung = y;
+}
+
+static void gen_all_sse2(dsfmt_t* x) {
+    dsfmt_w128_t* st = x->status;
+    __m128i lung = _mm_loadu_si128((const __m128i*)&st[DSFMT_N]);
+    int i;
+    for (i = 0; i < DSFMT_N - DSFMT_POS1; i++) recursion_sse2(&st[i], &st[i], &st[i + DSFMT_POS1], &lung);
+    for (; i < DSFMT_N; i++) recursion_sse2(&st[i], &st[i], &st[i + DSFMT_POS1 - DSFMT_N], &lung);
+    _mm_storeu_si128((__m128i*)&st[DSFMT_N], lung);
+}
+#else
+static int dsfmt_kernel = 0;
+#endif
+
+static inline void recursion_scalar(dsfmt_w128_t* r, const dsfmt_w128_t* a, const dsfmt_w128_t* b, dsfmt_w128_t* lung) {
+    uint64_t t0 = a->u[0], t1 = a->u[1], L0 = lung->u[0], L1 = lung->u[1];
+    lung->u[0] = (t0 << DSFMT_SL1) ^ (L1 >> 32) ^ (L1 << 32) ^ b->u[0];
+    lung->u[1] = (t1 << DSFMT_SL1) ^ (L0 >> 32) ^ (L0 << 32) ^ b->u[1];
+    r->u[0] = (lung->u[0] >> DSFMT_SR) ^ (lung->u[0] & DSFMT_MSK1) ^ t0;
+    r->u[1] = (lung->u[1] >> DSFMT_SR) ^ (lung->u[1] & DSFMT_MSK2) ^ t1;
+}
+
+static void gen_all_scalar(dsfmt_t* x) {
+    dsfmt_w128_t* st = x->status;
+    dsfmt_w128_t lung = st[DSFMT_N];
+    int i;
+    for (i = 0; i < DSFMT_N - DSFMT_POS1; i++) recursion_scalar(&st[i], &st[i], &st[i + DSFMT_POS1], &lung);
+    for (; i < DSFMT_N; i++) recursion_scalar(&st[i], &st[i], &st[i + DSFMT_POS1 - DSFMT_N], &lung);
+    st[DSFMT_N] = lung;
+}
+
+void dsfmt_gen_all(dsfmt_t* x) {
+#ifdef __SSE2__
+    if (__atomic_load_n(&dsfmt_kernel, __ATOMIC_RELAXED)) {
+        gen_all_sse2(x);
+        return;
+    }
+#endif
+    gen_all_scalar(x);
+}
+
+void dsfmt_set_kernel(int simd) {
+#ifdef __SSE2__
+    __atomic_store_n(&dsfmt_kernel, simd != 0, __ATOMIC_RELAXED);
+#else
+    (void)simd;
+#endif
+}
+
+int dsfmt_kernel_level(void) {
+    return __atomic_load_n(&dsfmt_kernel, __ATOMIC_RELAXED);
+}
+
+void dsfmt_seed(dsfmt_t* x, uint32_t seed) {
+    uint32_t w[(DSFMT_N + 1) * 4];
+    w[0] = seed;
+    for (uint32_t i = 1; i < (DSFMT_N + 1) * 4; i++)
+        w[i] = 1812433253UL * (w[i - 1] ^ (w[i - 1] >> 30)) + i;
+    for (int i = 0; i < DSFMT_N + 1; i++)
+        for (int j = 0; j < 2; j++)
+            x->status[i].u[j] = (uint64_t)w[4 * i + 2 * j] | ((uint64_t)w[4 * i + 2 * j + 1] << 32);
+    for (int i = 0; i < DSFMT_N; i++)
+        for (int j = 0; j < 2; j++)
+            x->status[i].u[j] = (x->status[i].u[j] & DSFMT_LOW_MASK) | DSFMT_HIGH_CONST;
+
+    // period certification on the lung
+    uint64_t t0 = x->status[DSFMT_N].u[0] ^ DSFMT_FIX1;
+    uint64_t t1 = x->status[DSFMT_N].u[1] ^ DSFMT_FIX2;
+    uint64_t inner = (t0 & DSFMT_PCV1) ^ (t1 & DSFMT_PCV2);
+    for (int i = 32; i > 0; i >>= 1) inner ^= inner >> i;
+    if ((inner & 1) == 0) x->status[DSFMT_N].u[1] ^= 1;
+    x->idx = DSFMT_N64;
+}
+
+// [0, 1) doubles: regenerate in place and subtract one, no int->double step
+void dsfmt_fill_close0_open1(dsfmt_t* x, double* out, size_t n) {
+    while (n) {
+        if (x->idx >= DSFMT_N64) {
+            dsfmt_gen_all(x);
+            x->idx = 0;
+        }
+        size_t take = (size_t)(DSFMT_N64 - x->idx);
+        if (take > n) take = n;
+        const double* src = &x->status[0].d[0] + x->idx;
+        for (size_t i = 0; i < take; i++) out[i] = src[i] - 1.0;
+        x->idx += (int)take;
+        out += take; n -= take;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef RNG_DSFMT_H
+#define RNG_DSFMT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// internal: dsfmt-19937, ieee doubles in [1, 2) straight from the recursion
+
+#define DSFMT_N 191
+#define DSFMT_N64 (DSFMT_N * 2)
+
+typedef union {
+    uint64_t u[2];
+    double d[2];
+} dsfmt_w128_t;
+
+typedef struct {
+    dsfmt_w128_t status[DSFMT_N + 1];  // status[DSFMT_N] is the lung
+    int idx;
+} dsfmt_t;
+
+void dsfmt_seed(dsfmt_t* x, uint32_t seed);
+void dsfmt_gen_all(dsfmt_t* x);
+void dsfmt_fill_close0_open1(dsfmt_t* x, double* out, size_t n);  // [0, 1), as the reference names it
+void dsfmt_set_kernel(int simd);  // 1 = sse2 recursion where compiled in, 0 = scalar
+int dsfmt_kernel_level(void);
+
+// raw bit pattern of the next [1, 2) double
+static inline uint64_t dsfmt_next_raw(dsfmt_t* x) {
+    if (x->idx >= DSFMT_N64) {
+        dsfmt_gen_all(x);
+        x->idx = 0;
+    }
+    int i = x->idx++;
+    return x->status[i >> 1].u[i & 1];
+}
+
+#endif
@@ -0,0 +1,96 @@
+#include "rng.h"
+#include <math.h>
+
+#define FAULT_CHUNK_BITS ((uint64_t)1 << 24)  // 2 mb per task in the parallel walk
+#define FAULT_KEY 0x6661756c74ULL             // "fault"
+
+// bit i of a buffer is bit i % 8 of byte i / 8, as for RNG_LFSR patterns
+static inline void flip(uint8_t* p, uint64_t i) {
+    p[i >> 3] ^= (uint8_t)(1u << (i & 7));
+}
+
+// geometric skipping: the gap to the next event is floor(log u / log(1 - p)),
+// one draw per event however small the rate. a burst of length L flips its
+// first and last bit and each inner bit with probability 1/2, the next gap
+// starts after it, and bursts are cut at the end of the buffer.
+uint64_t rng_fault_inject(rng_state_t* state, void* buf, uint64_t nbits, double rate, uint32_t burst) {
+    if (!state || !buf || !(rate > 0.0)) return 0;
+    uint8_t* p = buf;
+    double scale = rate >= 1.0 ? 0.0 : 1.0 / log1p(-rate);
+    uint64_t events = 0, pos = 0;
+    if (burst < 1) burst = 1;
+    while (pos < nbits) {
+        double gap = floor(log(1.0 - rng_next_double(state)) * scale);
+        if (!(gap < (double)(nbits - pos))) break;
+        pos += (uint64_t)gap;
+        flip(p, pos);
+        if (burst > 1) {
+            uint64_t end = nbits - pos < burst ? nbits : pos + burst;
+            for (uint64_t i = pos + 1; i + 1 < end; i++)
+                if (rng_next_bool(state)) flip(p, i);
+            if (end == pos + burst) flip(p, end - 1);
+            pos = end;
+        } else {
+            pos++;
+        }
+        events++;
+    }
+    return events;
+}
+
+typedef struct {
+    uint8_t* buf;
+    uint64_t nbits;
+    double rate;
+    uint32_t burst;
+    uint64_t events;
+} fault_job_t;
+
+static void fault_task(rng_state_t* rng, size_t task, void* ctx) {
+    fault_job_t* job = ctx;
+    uint64_t first = (uint64_t)task * FAULT_CHUNK_BITS;
+    uint64_t n = job->nbits - first < FAULT_CHUNK_BITS ? job->nbits - first : FAULT_CHUNK_BITS;
+    uint64_t e = rng_fault_inject(rng, job->buf + first / 8, n, job->rate, job->burst);
+    __atomic_fetch_add(&job->events, e, __ATOMIC_RELAXED);
+}
+
+// the buffer is split into fixed 2 mb chunks, chunk i drawing from the task
+// stream (seed, i), so the result depends on the seed and not on the thread
+// count. flips are memoryless, so chunking changes nothing statistically;
+// bursts are cut at chunk ends.
+uint64_t rng_fault_inject_parallel(rng_type_t type, uint64_t seed, void* buf, uint64_t nbits,
+                                   double rate, uint32_t burst, int num_threads) {
+    if (!buf || !nbits) return 0;
+    fault_job_t job = { buf, nbits, rate, burst, 0 };
+    size_t tasks = (size_t)((nbits + FAULT_CHUNK_BITS - 1) / FAULT_CHUNK_BITS);
+    if (!rng_run_tasks(type, rng_hash_key(seed, FAULT_KEY), NULL, tasks, num_threads, fault_task, &job))
+        return 0;
+    return job.events;
+}
+
+// uniform in [0, bound) for bounds past 32 bits: masked rejection, < 2 draws expected
+static uint64_t bounded64(rng_state_t* state, uint64_t bound) {
+    if (bound <= UINT32_MAX) return rng_next_bounded(state, (uint32_t)bound);
+    uint64_t mask = ~(uint64_t)0 >> __builtin_clzll(bound - 1), x;
+    do x = rng_next_uint64(state) & mask; while (x >= bound);
+    return x;
+}
+
+// exactly k of the nbits mask bits set, every k-subset equally likely.
+// floyd's algorithm takes k draws with no table; above half density the
+// complement is drawn instead.
+bool rng_fault_mask(rng_state_t* state, void* mask, uint64_t nbits, uint64_t k) {
+    if (!state || !mask || k > nbits) return 0;
+    uint8_t* p = mask;
+    bool invert = k > nbits / 2;
+    uint64_t m = invert ? nbits - k : k;
+    for (uint64_t i = 0; i < (nbits + 7) / 8; i++) p[i] = 0;
+    for (uint64_t j = nbits - m; j < nbits; j++) {
+        uint64_t t = bounded64(state, j + 1);
+        uint64_t pick = p[t >> 3] >> (t & 7) & 1 ? j : t;
+        flip(p, pick);
+    }
+    if (invert)
+        for (uint64_t i = 0; i < nbits; i++) flip(p, i);
+    return 1;
+}
@@ -0,0 +1,250 @@
+#include "rng.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.14159265358979323846
+#define FIELD_KEY 0x6669656c64ULL  // "field"
+#define FFT_LANES 16               // columns transformed together, one cache line pair per row
+#define FIELD_PADS 2               // embedding doublings tried before clipping eigenvalues
+
+// radix-2 fft over "lanes" interleaved sequences: element t of lane l sits
+// at t * lanes + l, so a batch of columns vectorizes across the lanes and
+// a single row is lanes = 1. forward sign, no scaling.
+typedef struct {
+    size_t n;
+    double* c;   // cos(2 pi k / n), k < n / 2
+    double* s;
+} fft_plan_t;
+
+static bool fft_plan(fft_plan_t* p, size_t n) {
+    p->n = n;
+    p->c = malloc((n / 2 + 1) * sizeof(double));
+    p->s = malloc((n / 2 + 1) * sizeof(double));
+    if (!p->c || !p->s) return 0;
+    for (size_t k = 0; k < n / 2; k++) {
+        p->c[k] = cos(2.0 * PI * (double)k / (double)n);
+        p->s[k] = sin(2.0 * PI * (double)k / (double)n);
+    }
+    return 1;
+}
+
+static void fft_plan_free(fft_plan_t* p) {
+    free(p->c);
+    free(p->s);
+}
+
+static void fft_lanes(const fft_plan_t* p, double* re, double* im, size_t lanes) {
+    const size_t n = p->n;
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j)
+            for (size_t l = 0; l < lanes; l++) {
+                double t = re[i * lanes + l]; re[i * lanes + l] = re[j * lanes + l]; re[j * lanes + l] = t;
+                t = im[i * lanes + l]; im[i * lanes + l] = im[j * lanes + l]; im[j * lanes + l] = t;
+            }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len / 2, step = n / len;
+        for (size_t i = 0; i < n; i += len)
+            for (size_t k = 0; k < half; k++) {
+                double wr = p->c[k * step], wi = -p->s[k * step];
+                double* ar = re + (i + k) * lanes; double* ai = im + (i + k) * lanes;
+                double* br = ar + half * lanes; double* bi = ai + half * lanes;
+                for (size_t l = 0; l < lanes; l++) {
+                    double tr = br[l] * wr - bi[l] * wi, ti = br[l] * wi + bi[l] * wr;
+                    br[l] = ar[l] - tr; bi[l] = ai[l] - ti;
+                    ar[l] += tr; ai[l] += ti;
+                }
+            }
+    }
+}
+
+// circulant embedding: the covariance on an m x n torus (m >= 2 (nx - 1),
+// powers of two) has the 2-d dft of its first row as eigenvalues. with z
+// complex white noise, fft(sqrt(lambda / (m n)) z) has real and imaginary
+// parts that are two independent fields with that covariance, so one
+// complex transform yields two fields.
+struct rng_field {
+    size_t nx, ny, m, n;
+    fft_plan_t pm, pn;
+    double* amp;           // sqrt(max(lambda, 0) / (m n)), row-major m x n
+    double *re, *im;
+    uint64_t seed, calls;
+    int num_threads;
+    double negative;       // clipped share of the eigenvalue mass
+    bool has_spare;        // imaginary part of the last transform not yet handed out
+};
+
+typedef struct {
+    rng_field_t* f;
+    int pass;              // 0: noise + rows, 1: columns, 2: rows only (setup)
+    bool failed;
+} field_job_t;
+
+static void field_task(rng_state_t* rng, size_t task, void* ctx) {
+    field_job_t* job = ctx;
+    rng_field_t* f = job->f;
+    const size_t n = f->n, m = f->m;
+    if (job->pass != 1) {
+        // task = row i
+        double* re = f->re + task * n;
+        double* im = f->im + task * n;
+        if (job->pass == 0) {
+            const double* a = f->amp + task * n;
+            rng_fill_distribution(rng, re, n);
+            rng_fill_distribution(rng, im, n);
+            for (size_t j = 0; j < n; j++) {
+                re[j] *= a[j];
+                im[j] *= a[j];
+            }
+        }
+        fft_lanes(&f->pn, re, im, 1);
+        return;
+    }
+    // task = a batch of FFT_LANES columns, gathered so rows stay contiguous
+    size_t c0 = task * FFT_LANES, lanes = n - c0 < FFT_LANES ? n - c0 : FFT_LANES;
+    double* br = malloc(2 * m * lanes * sizeof(double));
+    if (!br) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    double* bi = br + m * lanes;
+    for (size_t i = 0; i < m; i++) {
+        memcpy(br + i * lanes, f->re + i * n + c0, lanes * sizeof(double));
+        memcpy(bi + i * lanes, f->im + i * n + c0, lanes * sizeof(double));
+    }
+    fft_lanes(&f->pm, br, bi, lanes);
+    for (size_t i = 0; i < m; i++) {
+        memcpy(f->re + i * n + c0, br + i * lanes, lanes * sizeof(double));
+        memcpy(f->im + i * n + c0, bi + i * lanes, lanes * sizeof(double));
+    }
+    free(br);
+}
+
+// 2-d transform of re / im in place: rows, then column batches. pass 0
+// first writes the scaled noise, each row drawing from the task stream
+// (seed, call, row), so fields do not depend on the thread count.
+static bool fft2(rng_field_t* f, int pass) {
+    field_job_t job = { f, pass, 0 };
+    rng_params_t gp = { .gaussian = {0.0, 1.0} };
+    uint64_t seed = rng_hash_key(rng_hash_key(f->seed, FIELD_KEY), f->calls);
+    if (!rng_run_tasks(RNG_GAUSSIAN, seed, &gp, f->m, f->num_threads, field_task, &job)) return 0;
+    job.pass = 1;
+    return rng_run_tasks(RNG_XOSHIRO256PP, 1, NULL, (f->n + FFT_LANES - 1) / FFT_LANES,
+                         f->num_threads, field_task, &job) && !job.failed;
+}
+
+static size_t pow2_at_least(size_t x) {
+    size_t p = 1;
+    while (p < x) p <<= 1;
+    return p;
+}
+
+static void field_release(rng_field_t* f) {
+    fft_plan_free(&f->pm);
+    fft_plan_free(&f->pn);
+    free(f->amp);
+    free(f->re);
+    free(f->im);
+    f->amp = f->re = f->im = NULL;
+    f->pm.c = f->pm.s = f->pn.c = f->pn.s = NULL;
+}
+
+// eigenvalues for an m x n embedding; 0 on allocation failure
+static bool embed(rng_field_t* f, size_t m, size_t n, double spacing, rng_cov_fn cov, void* ctx) {
+    field_release(f);
+    f->m = m;
+    f->n = n;
+    f->amp = malloc(m * n * sizeof(double));
+    f->re = malloc(m * n * sizeof(double));
+    f->im = calloc(m * n, sizeof(double));
+    if (!f->amp || !f->re || !f->im || !fft_plan(&f->pm, m) || !fft_plan(&f->pn, n)) return 0;
+    for (size_t i = 0; i < m; i++)
+        for (size_t j = 0; j < n; j++) {
+            double dx = (double)(i < m - i ? i : m - i) * spacing;
+            double dy = (double)(j < n - j ? j : n - j) * spacing;
+            f->re[i * n + j] = cov(dx, dy, ctx);
+        }
+    if (!fft2(f, 2)) return 0;
+    double pos = 0.0, neg = 0.0;
+    for (size_t i = 0; i < m * n; i++) {
+        double l = f->re[i];
+        if (l > 0.0) pos += l;
+        else neg -= l;
+        f->amp[i] = sqrt((l > 0.0 ? l : 0.0) / (double)(m * n));
+    }
+    f->negative = pos + neg > 0.0 ? neg / (pos + neg) : 0.0;
+    return 1;
+}
+
+rng_field_t* rng_field_create(size_t nx, size_t ny, double spacing, rng_cov_fn cov, void* ctx,
+                              uint64_t seed, int num_threads) {
+    if (!nx || !ny || !cov || !(spacing > 0.0)) return NULL;
+    rng_field_t* f = calloc(1, sizeof(rng_field_t));
+    if (!f) return NULL;
+    f->nx = nx;
+    f->ny = ny;
+    f->seed = seed;
+    f->num_threads = num_threads;
+    size_t m = pow2_at_least(2 * (nx - 1)), n = pow2_at_least(2 * (ny - 1));
+    // a larger torus often removes negative eigenvalues; clip if it does not
+    for (int pad = 0; pad <= FIELD_PADS; pad++, m *= 2, n *= 2) {
+        if (!embed(f, m, n, spacing, cov, ctx)) {
+            rng_field_free(f);
+            return NULL;
+        }
+        if (f->negative < 1e-12) break;
+    }
+    return f;
+}
+
+void rng_field_free(rng_field_t* f) {
+    if (!f) return;
+    field_release(f);
+    free(f);
+}
+
+double rng_field_negative_mass(const rng_field_t* f) {
+    return f ? f->negative : 0.0;
+}
+
+// a and b are nx * ny row-major (a[x * ny + y]). with b NULL the second
+// field of the transform is kept and returned by the next call.
+bool rng_field_generate(rng_field_t* f, double* a, double* b) {
+    if (!f || !a) return 0;
+    const double* src;
+    if (f->has_spare) {
+        src = f->im;
+        f->has_spare = 0;
+    } else {
+        f->calls++;
+        if (!fft2(f, 0)) return 0;
+        src = f->re;
+        if (!b) f->has_spare = 1;
+    }
+    for (size_t x = 0; x < f->nx; x++) {
+        memcpy(a + x * f->ny, src + x * f->n, f->ny * sizeof(double));
+        if (b && src == f->re) memcpy(b + x * f->ny, f->im + x * f->n, f->ny * sizeof(double));
+    }
+    if (b && src == f->im) return rng_field_generate(f, b, NULL);
+    return 1;
+}
+
+double rng_cov_exponential(double dx, double dy, void* ctx) {
+    const rng_cov_params_t* p = ctx;
+    return p->sigma * p->sigma * exp(-sqrt(dx * dx + dy * dy) / p->length);
+}
+
+double rng_cov_gaussian(double dx, double dy, void* ctx) {
+    const rng_cov_params_t* p = ctx;
+    return p->sigma * p->sigma * exp(-(dx * dx + dy * dy) / (p->length * p->length));
+}
+
+double rng_cov_matern32(double dx, double dy, void* ctx) {
+    const rng_cov_params_t* p = ctx;
+    double r = sqrt(3.0 * (dx * dx + dy * dy)) / p->length;
+    return p->sigma * p->sigma * (1.0 + r) * exp(-r);
+}
@@ -0,0 +1,198 @@
+#include "rng.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IS_BLOCK 512         // samples per block in estimate
+#define IS_CE_SMOOTH 0.7     // weight of the new scale in a ce step
+#define IS_MIN_SCALE 1e-3
+
+// target is the standard normal in dim dimensions; the proposal is
+// N(shift, diag(scale^2)). with x = shift + scale * z,
+//   log w = log p(x) - log q(x) = sum(log scale) + sum(z^2 - x^2) / 2
+// so a weight costs one multiply-add per coordinate on top of the normal.
+struct rng_is {
+    rng_state_t* normal;
+    size_t dim;
+    double* shift;
+    double* scale;
+    double log_scale;        // sum of log scale
+    double* z;               // IS_BLOCK * dim normals
+};
+
+static void update_log_scale(rng_is_t* is) {
+    is->log_scale = 0.0;
+    for (size_t j = 0; j < is->dim; j++) is->log_scale += log(is->scale[j]);
+}
+
+rng_is_t* rng_is_create(size_t dim, uint64_t seed) {
+    if (!dim) return NULL;
+    rng_params_t p = { .gaussian = {0.0, 1.0} };
+    rng_is_t* is = calloc(1, sizeof(rng_is_t));
+    if (!is) return NULL;
+    is->dim = dim;
+    is->normal = rng_init(RNG_GAUSSIAN, seed, &p);
+    is->shift = calloc(dim, sizeof(double));
+    is->scale = malloc(dim * sizeof(double));
+    is->z = malloc(IS_BLOCK * dim * sizeof(double));
+    if (!is->normal || !is->shift || !is->scale || !is->z) {
+        rng_is_free(is);
+        return NULL;
+    }
+    for (size_t j = 0; j < dim; j++) is->scale[j] = 1.0;
+    return is;
+}
+
+void rng_is_free(rng_is_t* is) {
+    if (!is) return;
+    rng_free(is->normal);
+    free(is->shift);
+    free(is->scale);
+    free(is->z);
+    free(is);
+}
+
+bool rng_is_set_proposal(rng_is_t* is, const double* shift, const double* scale) {
+    if (!is) return 0;
+    for (size_t j = 0; scale && j < is->dim; j++)
+        if (!(scale[j] > 0.0)) return 0;
+    for (size_t j = 0; j < is->dim; j++) {
+        is->shift[j] = shift ? shift[j] : 0.0;
+        is->scale[j] = scale ? scale[j] : 1.0;
+    }
+    update_log_scale(is);
+    return 1;
+}
+
+bool rng_is_get_proposal(const rng_is_t* is, double* shift, double* scale) {
+    if (!is) return 0;
+    if (shift) memcpy(shift, is->shift, is->dim * sizeof(double));
+    if (scale) memcpy(scale, is->scale, is->dim * sizeof(double));
+    return 1;
+}
+
+// one block: m rows of x (row-major, dim wide) and their log weights
+static void sample_block(rng_is_t* is, double* x, double* logw, size_t m) {
+    const size_t d = is->dim;
+    rng_fill_distribution(is->normal, is->z, m * d);
+    for (size_t i = 0; i < m; i++) {
+        const double* z = is->z + i * d;
+        double* xi = x + i * d;
+        double acc = 0.0;
+        for (size_t j = 0; j < d; j++) {
+            double v = is->shift[j] + is->scale[j] * z[j];
+            xi[j] = v;
+            acc += z[j] * z[j] - v * v;
+        }
+        logw[i] = is->log_scale + 0.5 * acc;
+    }
+}
+
+bool rng_is_sample(rng_is_t* is, double* x, double* logw, size_t n) {
+    if (!is || !x || !logw) return 0;
+    for (size_t done = 0; done < n; done += IS_BLOCK) {
+        size_t m = n - done < IS_BLOCK ? n - done : IS_BLOCK;
+        sample_block(is, x + done * is->dim, logw + done, m);
+    }
+    return 1;
+}
+
+// p = E_q[w 1{score >= threshold}], with the relative standard error of the
+// mean and the effective sample size of the weights on the hits
+bool rng_is_estimate(rng_is_t* is, rng_is_score_fn fn, void* ctx, double threshold, size_t n,
+                     rng_is_result_t* out) {
+    if (!is || !fn || !out || !n) return 0;
+    double* x = malloc(IS_BLOCK * is->dim * sizeof(double));
+    double logw[IS_BLOCK], score[IS_BLOCK];
+    if (!x) return 0;
+    double s1 = 0.0, s2 = 0.0;
+    size_t hits = 0;
+    for (size_t done = 0; done < n; done += IS_BLOCK) {
+        size_t m = n - done < IS_BLOCK ? n - done : IS_BLOCK;
+        sample_block(is, x, logw, m);
+        fn(x, m, is->dim, score, ctx);
+        for (size_t i = 0; i < m; i++) {
+            if (!(score[i] >= threshold)) continue;
+            double w = exp(logw[i]);
+            s1 += w;
+            s2 += w * w;
+            hits++;
+        }
+    }
+    free(x);
+    double p = s1 / n, var = s2 / n - p * p;
+    out->estimate = p;
+    out->rel_err = p > 0.0 ? sqrt((var > 0.0 ? var : 0.0) / n) / p : INFINITY;
+    out->ess = s2 > 0.0 ? s1 * s1 / s2 : 0.0;
+    out->n = n;
+    out->hits = hits;
+    return 1;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// cross-entropy tuning: each round draws n samples, raises the level to
+// the (1 - rho) score quantile (capped at threshold) and refits the
+// proposal to the weighted elite samples. it stops once the level reaches
+// threshold, returning the round count, or 0 if max_iter runs out first.
+// the scale is refitted only when fit_scale is set, smoothed so a small
+// elite cannot collapse it.
+int rng_is_tune(rng_is_t* is, rng_is_score_fn fn, void* ctx, double threshold, size_t n,
+                double rho, int max_iter, bool fit_scale) {
+    if (!is || !fn || !(rho > 0.0 && rho < 1.0) || n < 2) return 0;
+    const size_t d = is->dim;
+    double* x = malloc(n * d * sizeof(double));
+    double* logw = malloc(n * sizeof(double));
+    double* score = malloc(n * sizeof(double));
+    double* sorted = malloc(n * sizeof(double));
+    double* mean = malloc(d * sizeof(double));
+    int rounds = 0;
+    if (!x || !logw || !score || !sorted || !mean) goto done;
+    for (int it = 1; it <= max_iter; it++) {
+        rng_is_sample(is, x, logw, n);
+        fn(x, n, d, score, ctx);
+        memcpy(sorted, score, n * sizeof(double));
+        qsort(sorted, n, sizeof(double), cmp_double);
+        double level = sorted[(size_t)((1.0 - rho) * (n - 1))];
+        if (level > threshold) level = threshold;
+
+        double wsum = 0.0;
+        for (size_t j = 0; j < d; j++) mean[j] = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            if (!(score[i] >= level)) continue;
+            double w = exp(logw[i]);
+            wsum += w;
+            for (size_t j = 0; j < d; j++) mean[j] += w * x[i * d + j];
+        }
+        if (!(wsum > 0.0)) continue;  // nothing usable this round, draw again
+        for (size_t j = 0; j < d; j++) mean[j] /= wsum;
+        if (fit_scale) {
+            for (size_t j = 0; j < d; j++) {
+                double v = 0.0;
+                for (size_t i = 0; i < n; i++) {
+                    if (!(score[i] >= level)) continue;
+                    double e = x[i * d + j] - mean[j];
+                    v += exp(logw[i]) * e * e;
+                }
+                double s = IS_CE_SMOOTH * sqrt(v / wsum) + (1.0 - IS_CE_SMOOTH) * is->scale[j];
+                is->scale[j] = s > IS_MIN_SCALE ? s : IS_MIN_SCALE;
+            }
+            update_log_scale(is);
+        }
+        memcpy(is->shift, mean, d * sizeof(double));
+        if (level >= threshold) {
+            rounds = it;
+            break;
+        }
+    }
+done:
+    free(x);
+    free(logw);
+    free(score);
+    free(sorted);
+    free(mean);
+    return rounds;
+}
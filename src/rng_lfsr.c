@@ -0,0 +1,117 @@
+#include "rng_lfsr.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int degree_of(uint64_t poly) {
+    return poly ? 64 - __builtin_clzll(poly) : 0;
+}
+
+// x^t reads b[n - t], which sits at bit degree - t of the window
+static uint64_t feedback_mask(uint64_t poly, int degree) {
+    uint64_t fb = 0;
+    for (int t = 1; t <= degree; t++)
+        if (poly >> (t - 1) & 1) fb |= (uint64_t)1 << (degree - t);
+    return fb;
+}
+
+static inline uint64_t step1(uint64_t w, uint64_t fb, int degree, uint64_t* bit) {
+    *bit = (uint64_t)__builtin_parityll(w & fb);
+    return (w >> 1) | (*bit << (degree - 1));
+}
+
+bool lfsr_init(lfsr_t* x, uint64_t poly) {
+    int degree = degree_of(poly), bytes = (degree + 7) >> 3;
+    if (!degree) return 0;
+    x->tab = calloc((size_t)bytes, sizeof(*x->tab));
+    if (!x->tab) return 0;
+    x->poly = poly;
+    x->degree = degree;
+    x->w = 1;
+
+    // by linearity each window bit contributes a fixed 64-bit output word;
+    // a table entry is the xor of the words of the bits set in its byte
+    uint64_t fb = feedback_mask(poly, degree), basis[64];
+    for (int j = 0; j < degree; j++) {
+        uint64_t w = (uint64_t)1 << j, out = 0, bit;
+        for (int k = 0; k < 64; k++) {
+            w = step1(w, fb, degree, &bit);
+            out |= bit << k;
+        }
+        basis[j] = out;
+    }
+    for (int b = 0; b < bytes; b++)
+        for (int v = 0; v < 256; v++) {
+            uint64_t out = 0;
+            for (int i = 0; i < 8 && 8 * b + i < degree; i++)
+                if (v >> i & 1) out ^= basis[8 * b + i];
+            x->tab[b][v] = out;
+        }
+    return 1;
+}
+
+void lfsr_free(lfsr_t* x) {
+    free(x->tab);
+    x->tab = NULL;
+}
+
+// the low degree bits of seed become the window; all-zero is the one
+// stuck state, it maps to all ones (the usual prbs start)
+void lfsr_seed(lfsr_t* x, uint64_t seed) {
+    uint64_t mask = x->degree == 64 ? ~(uint64_t)0 : ((uint64_t)1 << x->degree) - 1;
+    x->w = seed & mask ? seed & mask : mask;
+}
+
+typedef struct { uint64_t col[64]; } gf2_mat_t;
+
+static uint64_t mat_vec(const gf2_mat_t* m, uint64_t v) {
+    uint64_t r = 0;
+    for (int j = 0; v; j++, v >>= 1)
+        if (v & 1) r ^= m->col[j];
+    return r;
+}
+
+static void mat_mul(gf2_mat_t* c, const gf2_mat_t* a, const gf2_mat_t* b, int n) {
+    gf2_mat_t t;
+    for (int j = 0; j < n; j++) t.col[j] = mat_vec(a, b->col[j]);
+    *c = t;
+}
+
+// window after nbits more steps: square-and-multiply on the one-step
+// matrix, o(degree^2 log nbits) word operations
+void lfsr_jump(lfsr_t* x, uint64_t nbits) {
+    int n = x->degree;
+    uint64_t fb = feedback_mask(x->poly, n), bit;
+    gf2_mat_t m, r;
+    for (int j = 0; j < n; j++) {
+        m.col[j] = step1((uint64_t)1 << j, fb, n, &bit);
+        r.col[j] = (uint64_t)1 << j;
+    }
+    for (; nbits; nbits >>= 1) {
+        if (nbits & 1) mat_mul(&r, &m, &r, n);
+        if (nbits > 1) mat_mul(&m, &m, &m, n);
+    }
+    x->w = mat_vec(&r, x->w);
+}
+
+// self-synchronizing checker: every bit after the first degree is
+// predicted from the received bits before it, word-parallel over the taps.
+// a single line error shows up once per term of poly (3 for prbs trinomials).
+uint64_t lfsr_check(uint64_t poly, const uint8_t* data, size_t nbits) {
+    int degree = degree_of(poly);
+    if (!degree || !data) return 0;
+    uint64_t errors = 0, prev = 0;
+    for (size_t base = 0; base < nbits; base += 64) {
+        uint64_t cur = 0;
+        size_t left = (nbits - base + 7) / 8;
+        memcpy(&cur, data + base / 8, left < 8 ? left : 8);
+        uint64_t pred = 0;
+        for (int t = 1; t <= degree; t++)
+            if (poly >> (t - 1) & 1) pred ^= t == 64 ? prev : (cur << t) | (prev >> (64 - t));
+        uint64_t valid = ~(uint64_t)0;
+        if (base < (size_t)degree) valid = degree - base >= 64 ? 0 : valid << (degree - base);
+        if (nbits - base < 64) valid &= ((uint64_t)1 << (nbits - base)) - 1;
+        errors += (uint64_t)__builtin_popcountll((cur ^ pred) & valid);
+        prev = cur;
+    }
+    return errors;
+}
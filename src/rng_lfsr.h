@@ -0,0 +1,36 @@
+#ifndef RNG_LFSR_H
+#define RNG_LFSR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// internal: word-parallel lfsr / prbs bit sequences of degree <= 64.
+// the sequence is b[n] = xor of b[n - t] over the x^t terms of poly (bit
+// t - 1 set for x^t, the +1 implicit); output words carry 64 consecutive
+// bits, earliest in bit 0.
+
+typedef struct {
+    uint64_t w;              // last degree bits, oldest in bit 0
+    uint64_t poly;
+    int degree;
+    uint64_t (*tab)[256];    // per window byte: the next 64 output bits it contributes
+} lfsr_t;
+
+bool lfsr_init(lfsr_t* x, uint64_t poly);
+void lfsr_free(lfsr_t* x);
+void lfsr_seed(lfsr_t* x, uint64_t seed);
+void lfsr_jump(lfsr_t* x, uint64_t nbits);
+uint64_t lfsr_check(uint64_t poly, const uint8_t* data, size_t nbits);
+
+// 64 bits per step: one table lookup per window byte, and the new window
+// is the top degree bits of the output
+static inline uint64_t lfsr_step(lfsr_t* x) {
+    uint64_t w = x->w, out = 0;
+    int bytes = (x->degree + 7) >> 3;
+    for (int b = 0; b < bytes; b++) out ^= x->tab[b][(w >> (8 * b)) & 0xff];
+    x->w = out >> (64 - x->degree);
+    return out;
+}
+
+#endif
@@ -0,0 +1,359 @@
+#include "rng.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MCMC_GROUP 256          // chains per task, the unit of threading
+#define CHAIN_UNIFORMS 32       // buffered uniforms per chain stream
+#define SLICE_MAX_OUT 32        // stepping-out rounds, split at random between the sides
+#define SLICE_MAX_SHRINK 64     // shrink rounds before a chain stays put
+
+// chain c draws from its own xoshiro256++ stream, c jumps (2^128 steps
+// each) past chain 0, refilled CHAIN_UNIFORMS at a time. normals come
+// from the polar method over those uniforms.
+typedef struct {
+    rng_state_t* rng;
+    double u[CHAIN_UNIFORMS];
+    size_t upos;
+    bool has_cache;
+    double cache;
+} chain_stream_t;
+
+// a group holds k chains in struct-of-arrays form: coordinate j of chain c
+// at x[j * k + c]. the log density is evaluated for the whole group at once,
+// so every proposal batch is a single callback.
+typedef struct {
+    size_t first, k;
+    bool ready;                      // logp / grad match x
+    double *x, *logp, *grad;         // current positions
+    double *y, *logp_y, *grad_y;     // proposals
+    double *z, *p;                   // normals / directions, hmc momenta
+    double *lo, *hi, *level;         // slice brackets and heights
+    unsigned char* active;
+    uint64_t accepted, proposed, evals;
+} mcmc_group_t;
+
+struct rng_mcmc {
+    rng_mcmc_kind_t kind;
+    size_t chains, dim, ngroups;
+    rng_logp_fn fn;
+    void* ctx;
+    double step;
+    int leapfrog;
+    chain_stream_t* streams;
+    mcmc_group_t* groups;
+    // arguments of the current run
+    size_t steps, thin;
+    double* out;
+};
+
+static double chain_uniform(chain_stream_t* s) {
+    if (s->upos >= CHAIN_UNIFORMS) {
+        rng_fill_double(s->rng, s->u, CHAIN_UNIFORMS);
+        s->upos = 0;
+    }
+    return s->u[s->upos++];
+}
+
+static double chain_normal(chain_stream_t* s) {
+    if (s->has_cache) {
+        s->has_cache = 0;
+        return s->cache;
+    }
+    for (;;) {
+        double u1 = 2.0 * chain_uniform(s) - 1.0, u2 = 2.0 * chain_uniform(s) - 1.0;
+        double r = u1 * u1 + u2 * u2;
+        if (r >= 1.0 || r == 0.0) continue;
+        r = sqrt(-2.0 * log(r) / r);
+        s->cache = u2 * r;
+        s->has_cache = 1;
+        return u1 * r;
+    }
+}
+
+// log of a uniform on (0, 1], finite
+static inline double chain_log_uniform(chain_stream_t* s) {
+    return log(1.0 - chain_uniform(s));
+}
+
+static void free_group(mcmc_group_t* g) {
+    free(g->x); free(g->logp); free(g->grad);
+    free(g->y); free(g->logp_y); free(g->grad_y);
+    free(g->z); free(g->p);
+    free(g->lo); free(g->hi); free(g->level);
+    free(g->active);
+}
+
+static bool alloc_group(mcmc_group_t* g, size_t dim) {
+    size_t k = g->k, n = dim * k * sizeof(double);
+    g->x = calloc(1, n); g->grad = malloc(n);
+    g->y = malloc(n); g->grad_y = malloc(n);
+    g->z = malloc(n); g->p = malloc(n);
+    g->logp = malloc(k * sizeof(double)); g->logp_y = malloc(k * sizeof(double));
+    g->lo = malloc(k * sizeof(double)); g->hi = malloc(k * sizeof(double));
+    g->level = malloc(k * sizeof(double));
+    g->active = malloc(k);
+    return g->x && g->grad && g->y && g->grad_y && g->z && g->p && g->logp && g->logp_y &&
+           g->lo && g->hi && g->level && g->active;
+}
+
+void rng_mcmc_free(rng_mcmc_t* m) {
+    if (!m) return;
+    for (size_t c = 0; m->streams && c < m->chains; c++) rng_free(m->streams[c].rng);
+    for (size_t g = 0; m->groups && g < m->ngroups; g++) free_group(&m->groups[g]);
+    free(m->streams);
+    free(m->groups);
+    free(m);
+}
+
+rng_mcmc_t* rng_mcmc_create(rng_mcmc_kind_t kind, size_t chains, size_t dim, rng_logp_fn fn,
+                            void* ctx, uint64_t seed) {
+    if (!chains || !dim || !fn || kind > RNG_MCMC_HMC) return NULL;
+    rng_mcmc_t* m = calloc(1, sizeof(rng_mcmc_t));
+    if (!m) return NULL;
+    m->kind = kind;
+    m->chains = chains;
+    m->dim = dim;
+    m->fn = fn;
+    m->ctx = ctx;
+    m->step = kind == RNG_MCMC_MH ? 2.38 / sqrt((double)dim) : kind == RNG_MCMC_SLICE ? 2.0 : 0.2;
+    m->leapfrog = 10;
+    m->ngroups = (chains + MCMC_GROUP - 1) / MCMC_GROUP;
+    m->streams = calloc(chains, sizeof(chain_stream_t));
+    m->groups = calloc(m->ngroups, sizeof(mcmc_group_t));
+    if (!m->streams || !m->groups) goto fail;
+    for (size_t c = 0; c < chains; c++) {
+        chain_stream_t* s = &m->streams[c];
+        s->rng = c ? rng_clone(m->streams[c - 1].rng) : rng_init(RNG_XOSHIRO256PP, seed, NULL);
+        if (!s->rng || (c && !rng_jump(s->rng))) goto fail;
+        s->upos = CHAIN_UNIFORMS;
+    }
+    for (size_t g = 0; g < m->ngroups; g++) {
+        m->groups[g].first = g * MCMC_GROUP;
+        m->groups[g].k = chains - g * MCMC_GROUP < MCMC_GROUP ? chains - g * MCMC_GROUP : MCMC_GROUP;
+        if (!alloc_group(&m->groups[g], dim)) goto fail;
+    }
+    return m;
+fail:
+    rng_mcmc_free(m);
+    return NULL;
+}
+
+bool rng_mcmc_set_step(rng_mcmc_t* m, double step, int leapfrog) {
+    if (!m || !(step > 0.0) || leapfrog < 1) return 0;
+    m->step = step;
+    m->leapfrog = leapfrog;
+    return 1;
+}
+
+// x is dim * chains, coordinate j of chain c at x[j * chains + c]
+bool rng_mcmc_set_position(rng_mcmc_t* m, const double* x) {
+    if (!m || !x) return 0;
+    for (size_t g = 0; g < m->ngroups; g++) {
+        mcmc_group_t* gr = &m->groups[g];
+        for (size_t j = 0; j < m->dim; j++)
+            memcpy(gr->x + j * gr->k, x + j * m->chains + gr->first, gr->k * sizeof(double));
+        gr->ready = 0;
+    }
+    return 1;
+}
+
+bool rng_mcmc_get_position(const rng_mcmc_t* m, double* x) {
+    if (!m || !x) return 0;
+    for (size_t g = 0; g < m->ngroups; g++) {
+        const mcmc_group_t* gr = &m->groups[g];
+        for (size_t j = 0; j < m->dim; j++)
+            memcpy(x + j * m->chains + gr->first, gr->x + j * gr->k, gr->k * sizeof(double));
+    }
+    return 1;
+}
+
+double rng_mcmc_acceptance(const rng_mcmc_t* m) {
+    uint64_t a = 0, p = 0;
+    for (size_t g = 0; m && g < m->ngroups; g++) {
+        a += m->groups[g].accepted;
+        p += m->groups[g].proposed;
+    }
+    return p ? (double)a / p : 0.0;
+}
+
+double rng_mcmc_evals_per_step(const rng_mcmc_t* m) {
+    uint64_t e = 0, p = 0;
+    for (size_t g = 0; m && g < m->ngroups; g++) {
+        e += m->groups[g].evals;
+        p += m->groups[g].proposed;
+    }
+    return p ? (double)e / p : 0.0;
+}
+
+static void eval(const rng_mcmc_t* m, mcmc_group_t* g, const double* x, double* logp, double* grad) {
+    m->fn(x, g->k, m->dim, logp, grad, m->ctx);
+    g->evals += g->k;
+}
+
+static void accept_column(mcmc_group_t* g, size_t dim, size_t c, bool with_grad) {
+    for (size_t j = 0; j < dim; j++) {
+        g->x[j * g->k + c] = g->y[j * g->k + c];
+        if (with_grad) g->grad[j * g->k + c] = g->grad_y[j * g->k + c];
+    }
+    g->logp[c] = g->logp_y[c];
+    g->accepted++;
+}
+
+// random-walk metropolis, N(0, step^2 I) increments
+static void mh_step(const rng_mcmc_t* m, mcmc_group_t* g, chain_stream_t* st) {
+    const size_t k = g->k, d = m->dim;
+    for (size_t c = 0; c < k; c++)
+        for (size_t j = 0; j < d; j++) g->z[j * k + c] = chain_normal(&st[c]);
+    for (size_t i = 0; i < d * k; i++) g->y[i] = g->x[i] + m->step * g->z[i];
+    eval(m, g, g->y, g->logp_y, NULL);
+    for (size_t c = 0; c < k; c++)
+        if (chain_log_uniform(&st[c]) < g->logp_y[c] - g->logp[c]) accept_column(g, d, c, 0);
+    g->proposed += k;
+}
+
+// y = x + t * direction for every chain, t = 0 where inactive
+static void slice_point(const rng_mcmc_t* m, mcmc_group_t* g, const double* t) {
+    const size_t k = g->k;
+    for (size_t j = 0; j < m->dim; j++)
+        for (size_t c = 0; c < k; c++)
+            g->y[j * k + c] = g->x[j * k + c] + (g->active[c] ? t[c] : 0.0) * g->z[j * k + c];
+}
+
+// hit-and-run slice sampling: a uniform random direction, a bracket of
+// width step around x stepped out until both ends leave the slice (at most
+// SLICE_MAX_OUT - 1 steps in all, j = floor(m v) of them to the left and
+// the rest to the right as in neal 2003, which keeps a capped bracket
+// reversible), then
+// shrinkage. chains run in lockstep; every round evaluates the whole group
+// and finished chains ignore the result.
+static void slice_step(const rng_mcmc_t* m, mcmc_group_t* g, chain_stream_t* st) {
+    const size_t k = g->k, d = m->dim;
+    double* t = g->p;  // the momentum buffer is free here
+    for (size_t c = 0; c < k; c++) {
+        double norm = 0.0;
+        for (size_t j = 0; j < d; j++) {
+            double z = chain_normal(&st[c]);
+            g->z[j * k + c] = z;
+            norm += z * z;
+        }
+        norm = 1.0 / sqrt(norm);
+        for (size_t j = 0; j < d; j++) g->z[j * k + c] *= norm;
+        g->level[c] = g->logp[c] + chain_log_uniform(&st[c]);
+        g->lo[c] = -m->step * chain_uniform(&st[c]);
+        g->hi[c] = g->lo[c] + m->step;
+        // active holds the steps left on the current side, t the right budget
+        int j = (int)(SLICE_MAX_OUT * chain_uniform(&st[c]));
+        g->active[c] = (unsigned char)j;
+        t[c] = SLICE_MAX_OUT - 1 - j;
+    }
+    for (int side = 0; side < 2; side++) {
+        double* end = side ? g->hi : g->lo;
+        double dir = side ? m->step : -m->step;
+        bool any = 0;
+        for (size_t c = 0; c < k; c++) {
+            if (side) g->active[c] = (unsigned char)t[c];
+            any = any || g->active[c];
+        }
+        while (any) {
+            slice_point(m, g, end);
+            eval(m, g, g->y, g->logp_y, NULL);
+            any = 0;
+            for (size_t c = 0; c < k; c++) {
+                if (!g->active[c]) continue;
+                if (g->logp_y[c] > g->level[c]) {
+                    end[c] += dir;
+                    if (--g->active[c]) any = 1;
+                } else {
+                    g->active[c] = 0;
+                }
+            }
+        }
+    }
+    memset(g->active, 1, k);
+    size_t left = k;
+    for (int round = 0; round < SLICE_MAX_SHRINK && left; round++) {
+        for (size_t c = 0; c < k; c++)
+            if (g->active[c]) t[c] = g->lo[c] + (g->hi[c] - g->lo[c]) * chain_uniform(&st[c]);
+        slice_point(m, g, t);
+        eval(m, g, g->y, g->logp_y, NULL);
+        for (size_t c = 0; c < k; c++) {
+            if (!g->active[c]) continue;
+            if (g->logp_y[c] > g->level[c]) {
+                accept_column(g, d, c, 0);
+                g->active[c] = 0;
+                left--;
+            } else if (t[c] < 0.0) {
+                g->lo[c] = t[c];
+            } else {
+                g->hi[c] = t[c];
+            }
+        }
+    }
+    g->proposed += k;
+}
+
+// hamiltonian monte carlo with unit mass, leapfrog steps of size step
+static void hmc_step(const rng_mcmc_t* m, mcmc_group_t* g, chain_stream_t* st) {
+    const size_t k = g->k, d = m->dim, n = d * k;
+    const double eps = m->step;
+    double* h0 = g->level;
+    for (size_t c = 0; c < k; c++) {
+        double kin = 0.0;
+        for (size_t j = 0; j < d; j++) {
+            double p = chain_normal(&st[c]);
+            g->p[j * k + c] = p;
+            kin += p * p;
+        }
+        h0[c] = 0.5 * kin - g->logp[c];
+    }
+    memcpy(g->y, g->x, n * sizeof(double));
+    memcpy(g->grad_y, g->grad, n * sizeof(double));
+    for (size_t i = 0; i < n; i++) g->p[i] += 0.5 * eps * g->grad_y[i];
+    for (int l = 0; l < m->leapfrog; l++) {
+        for (size_t i = 0; i < n; i++) g->y[i] += eps * g->p[i];
+        eval(m, g, g->y, g->logp_y, g->grad_y);
+        double kick = l + 1 < m->leapfrog ? eps : 0.5 * eps;
+        for (size_t i = 0; i < n; i++) g->p[i] += kick * g->grad_y[i];
+    }
+    for (size_t c = 0; c < k; c++) {
+        double kin = 0.0;
+        for (size_t j = 0; j < d; j++) kin += g->p[j * k + c] * g->p[j * k + c];
+        double h1 = 0.5 * kin - g->logp_y[c];
+        if (chain_log_uniform(&st[c]) < h0[c] - h1) accept_column(g, d, c, 1);
+    }
+    g->proposed += k;
+}
+
+static void mcmc_task(rng_state_t* rng, size_t task, void* ctx) {
+    (void)rng;  // chains carry their own streams
+    rng_mcmc_t* m = ctx;
+    mcmc_group_t* g = &m->groups[task];
+    chain_stream_t* st = m->streams + g->first;
+    if (!g->ready) {
+        eval(m, g, g->x, g->logp, m->kind == RNG_MCMC_HMC ? g->grad : NULL);
+        g->ready = 1;
+    }
+    for (size_t s = 0; s < m->steps; s++) {
+        switch (m->kind) {
+            case RNG_MCMC_MH: mh_step(m, g, st); break;
+            case RNG_MCMC_SLICE: slice_step(m, g, st); break;
+            case RNG_MCMC_HMC: hmc_step(m, g, st); break;
+        }
+        if (m->out && (s + 1) % m->thin == 0) {
+            double* snap = m->out + ((s + 1) / m->thin - 1) * m->dim * m->chains;
+            for (size_t j = 0; j < m->dim; j++)
+                memcpy(snap + j * m->chains + g->first, g->x + j * g->k, g->k * sizeof(double));
+        }
+    }
+}
+
+// groups of 256 chains are tasks on the work-stealing runner. each chain
+// only touches its own stream, so results do not depend on num_threads.
+bool rng_mcmc_run(rng_mcmc_t* m, size_t steps, size_t thin, double* out, int num_threads) {
+    if (!m || (out && !thin)) return 0;
+    m->steps = steps;
+    m->thin = thin;
+    m->out = out;
+    return rng_run_tasks(RNG_XOSHIRO256PP, 1, NULL, m->ngroups, num_threads, mcmc_task, m);
+}
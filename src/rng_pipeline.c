@@ -0,0 +1,157 @@
+#include "rng.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define PIPE_BLOCK 512        // values per block, source and output stay in l1
+#define PIPE_UNIFORMS 1024    // uniform buffer feeding the polar method
+#define ROUND_MAGIC 6755399441055744.0  // 1.5 * 2^52, adding it rounds to nearest even
+
+typedef enum { SOURCE_UNIFORM, SOURCE_GAUSSIAN } pipe_source_t;
+
+// every chain is kept compiled to one canonical form,
+//   out = quantize(clamp(mul * source + add, lo, hi))
+// affine stages fold into mul/add, and an affine after a clamp is pushed
+// through it (bounds are mapped, swapped when the factor is negative), so
+// any number of stages costs one multiply-add, one clamp and one rounding.
+struct rng_pipeline {
+    rng_state_t* engine;
+    pipe_source_t source;
+    bool has_source, has_clamp, quantized;
+    double mul, add, lo, hi;
+    size_t upos;
+    bool has_cache;
+    double cache;
+    double u[PIPE_UNIFORMS];
+    double block[PIPE_BLOCK];
+};
+
+rng_pipeline_t* rng_pipeline_create(rng_type_t engine, uint64_t seed) {
+    rng_pipeline_t* p = malloc(sizeof(rng_pipeline_t));
+    if (!p) return NULL;
+    p->engine = rng_init(engine, seed, NULL);
+    if (!p->engine) {
+        free(p);
+        return NULL;
+    }
+    p->source = SOURCE_UNIFORM;
+    p->has_source = p->has_clamp = p->quantized = p->has_cache = 0;
+    p->mul = 1.0; p->add = 0.0;
+    p->lo = -INFINITY; p->hi = INFINITY;
+    p->upos = PIPE_UNIFORMS;
+    return p;
+}
+
+void rng_pipeline_free(rng_pipeline_t* p) {
+    if (!p) return;
+    rng_free(p->engine);
+    free(p);
+}
+
+// a source must come first, before any transform
+static bool add_source(rng_pipeline_t* p, pipe_source_t source, double mul, double add) {
+    if (!p || p->has_source || p->has_clamp || p->quantized || p->mul != 1.0 || p->add != 0.0) return 0;
+    p->source = source;
+    p->has_source = 1;
+    p->mul = mul;
+    p->add = add;
+    return 1;
+}
+
+bool rng_pipeline_add_uniform(rng_pipeline_t* p, double lo, double hi) {
+    return add_source(p, SOURCE_UNIFORM, hi - lo, lo);
+}
+
+bool rng_pipeline_add_gaussian(rng_pipeline_t* p, double mean, double stddev) {
+    return add_source(p, SOURCE_GAUSSIAN, stddev, mean);
+}
+
+bool rng_pipeline_add_scale(rng_pipeline_t* p, double mul, double add) {
+    if (!p || p->quantized) return 0;
+    p->mul = mul * p->mul;
+    p->add = mul * p->add + add;
+    if (p->has_clamp && mul == 0.0) {
+        p->lo = p->hi = add;  // 0 * inf would poison an open bound
+    } else if (p->has_clamp) {
+        double lo = mul * p->lo + add, hi = mul * p->hi + add;
+        p->lo = mul < 0 ? hi : lo;
+        p->hi = mul < 0 ? lo : hi;
+    }
+    return 1;
+}
+
+bool rng_pipeline_add_clamp(rng_pipeline_t* p, double lo, double hi) {
+    if (!p || p->quantized || !(lo <= hi)) return 0;
+    // clamp(clamp(x, a, b), lo, hi) == clamp(x, clamp(a, lo, hi), clamp(b, lo, hi))
+    p->lo = p->lo < lo ? lo : p->lo > hi ? hi : p->lo;
+    p->hi = p->hi < lo ? lo : p->hi > hi ? hi : p->hi;
+    p->has_clamp = 1;
+    return 1;
+}
+
+// round(x * scale) to nearest even, saturated to the int16 range. terminal.
+bool rng_pipeline_add_quantize_int16(rng_pipeline_t* p, double scale) {
+    if (!p || p->quantized || !rng_pipeline_add_scale(p, scale, 0.0) ||
+        !rng_pipeline_add_clamp(p, -32768.0, 32767.0))
+        return 0;
+    p->quantized = 1;
+    return 1;
+}
+
+// standard normals by the polar method over the engine's uniforms. a pair
+// split by the end of a block is kept, so block size never shifts the stream.
+static void gaussian_block(rng_pipeline_t* p, double* out, size_t n) {
+    size_t i = 0;
+    if (p->has_cache && n) {
+        out[i++] = p->cache;
+        p->has_cache = 0;
+    }
+    while (i < n) {
+        if (p->upos + 2 > PIPE_UNIFORMS) {
+            rng_fill_double(p->engine, p->u, PIPE_UNIFORMS);
+            p->upos = 0;
+        }
+        double u1 = 2.0 * p->u[p->upos] - 1.0, u2 = 2.0 * p->u[p->upos + 1] - 1.0;
+        p->upos += 2;
+        double r = u1 * u1 + u2 * u2;
+        if (r >= 1.0 || r == 0.0) continue;
+        r = sqrt(-2.0 * log(r) / r);
+        out[i++] = u1 * r;
+        if (i < n) out[i++] = u2 * r;
+        else {
+            p->cache = u2 * r;
+            p->has_cache = 1;
+        }
+    }
+}
+
+// out is double[n], or int16_t[n] once quantize_int16 has been added
+bool rng_pipeline_run(rng_pipeline_t* p, void* out, size_t n) {
+    if (!p || !out || !n) return 0;
+    const double mul = p->mul, add = p->add, lo = p->lo, hi = p->hi;
+    for (size_t done = 0; done < n; done += PIPE_BLOCK) {
+        size_t m = n - done < PIPE_BLOCK ? n - done : PIPE_BLOCK;
+        double* x = p->block;
+        if (p->source == SOURCE_GAUSSIAN) gaussian_block(p, x, m);
+        else rng_fill_double(p->engine, x, m);
+        if (p->quantized) {
+            int16_t* q = (int16_t*)out + done;
+            for (size_t i = 0; i < m; i++) {
+                double y = mul * x[i] + add;
+                y = y < lo ? lo : y;
+                y = y > hi ? hi : y;
+                q[i] = (int16_t)((y + ROUND_MAGIC) - ROUND_MAGIC);
+            }
+        } else if (p->has_clamp) {
+            double* d = (double*)out + done;
+            for (size_t i = 0; i < m; i++) {
+                double y = mul * x[i] + add;
+                y = y < lo ? lo : y;
+                d[i] = y > hi ? hi : y;
+            }
+        } else {
+            double* d = (double*)out + done;
+            for (size_t i = 0; i < m; i++) d[i] = mul * x[i] + add;
+        }
+    }
+    return 1;
+}
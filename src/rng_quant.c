@@ -0,0 +1,107 @@
+#include "rng.h"
+#include <string.h>
+
+#define QUANT_BLOCK 2048  // elements per block, 16 random bits each: 4 kb of draws
+
+// every kernel takes 16 bits of the engine's byte stream per element, in
+// blocks filled with rng_fill_bytes, and is branch-free per element so the
+// loops vectorize. nan inputs stay nan for the float formats and give 0 for
+// the integer ones.
+
+static inline uint32_t float_bits(float x) {
+    uint32_t b;
+    memcpy(&b, &x, 4);
+    return b;
+}
+
+// bf16 keeps the top half of the float: adding 16 random low bits carries
+// into it with probability equal to the dropped fraction
+static inline uint16_t bf16_sr(float x, uint16_t r) {
+    uint32_t b = float_bits(x);
+    uint16_t up = (uint16_t)((b + r) >> 16);
+    uint16_t nan = (uint16_t)((b >> 16) | 0x40);
+    return (b & 0x7fffffff) > 0x7f800000 ? nan : up;
+}
+
+// normal half range: the same carry trick on the 13 bits below the 10-bit
+// mantissa, then rebias. half subnormals are multiples of 2^-24 and are
+// rounded in fixed point.
+static inline uint16_t fp16_sr(float x, uint16_t r) {
+    uint32_t b = float_bits(x);
+    uint32_t sign = (b >> 16) & 0x8000, a = b & 0x7fffffff;
+    uint32_t normal = ((a + (r & 0x1fff)) >> 13) - ((127 - 15) << 10);
+    normal = normal > 0x7c00 ? 0x7c00 : normal;
+    float q = (x < 0 ? -x : x) * 0x1p24f;
+    q = q < 2048.0f ? q : 0.0f;  // only used below 2^-14, keeps the cast defined
+    uint32_t k = (uint32_t)q;
+    k += (q - (float)k) * 65536.0f > (float)r;
+    uint32_t h = a >= 0x38800000 ? normal : k;
+    h = a >= 0x7f800000 ? 0x7c00 | (a > 0x7f800000 ? 0x200 : 0) : h;
+    return (uint16_t)(sign | h);
+}
+
+static inline int32_t floor_int(float y) {
+    int32_t k = (int32_t)y;
+    return k - (y < (float)k);
+}
+
+bool rng_round_bf16(rng_state_t* state, const float* in, uint16_t* out, size_t n) {
+    uint16_t r[QUANT_BLOCK];
+    if (!state || !in || !out) return 0;
+    for (size_t done = 0; done < n; done += QUANT_BLOCK) {
+        size_t m = n - done < QUANT_BLOCK ? n - done : QUANT_BLOCK;
+        rng_fill_bytes(state, r, 2 * m);
+        for (size_t i = 0; i < m; i++) out[done + i] = bf16_sr(in[done + i], r[i]);
+    }
+    return 1;
+}
+
+bool rng_round_fp16(rng_state_t* state, const float* in, uint16_t* out, size_t n) {
+    uint16_t r[QUANT_BLOCK];
+    if (!state || !in || !out) return 0;
+    for (size_t done = 0; done < n; done += QUANT_BLOCK) {
+        size_t m = n - done < QUANT_BLOCK ? n - done : QUANT_BLOCK;
+        rng_fill_bytes(state, r, 2 * m);
+        for (size_t i = 0; i < m; i++) out[done + i] = fp16_sr(in[done + i], r[i]);
+    }
+    return 1;
+}
+
+// in * scale, saturated to [-128, 127], rounded up with probability equal
+// to its fractional part
+bool rng_round_int8(rng_state_t* state, const float* in, int8_t* out, size_t n, float scale) {
+    uint16_t r[QUANT_BLOCK];
+    if (!state || !in || !out) return 0;
+    for (size_t done = 0; done < n; done += QUANT_BLOCK) {
+        size_t m = n - done < QUANT_BLOCK ? n - done : QUANT_BLOCK;
+        rng_fill_bytes(state, r, 2 * m);
+        for (size_t i = 0; i < m; i++) {
+            float y = in[done + i] * scale;
+            y = y == y ? y : 0.0f;
+            y = y < -128.0f ? -128.0f : y > 127.0f ? 127.0f : y;
+            int32_t k = floor_int(y);
+            k += (y - (float)k) * 65536.0f > (float)r[i];
+            out[done + i] = (int8_t)k;
+        }
+    }
+    return 1;
+}
+
+// tpdf dither: in * scale plus the difference of two 8-bit uniforms (a
+// triangular pdf over +-1 lsb), rounded to nearest and saturated to int16
+bool rng_dither_int16(rng_state_t* state, const float* in, int16_t* out, size_t n, float scale) {
+    uint16_t r[QUANT_BLOCK];
+    if (!state || !in || !out) return 0;
+    for (size_t done = 0; done < n; done += QUANT_BLOCK) {
+        size_t m = n - done < QUANT_BLOCK ? n - done : QUANT_BLOCK;
+        rng_fill_bytes(state, r, 2 * m);
+        for (size_t i = 0; i < m; i++) {
+            float d = ((float)(r[i] & 0xff) - (float)(r[i] >> 8)) * (1.0f / 256.0f);
+            float y = in[done + i] * scale + d;
+            y = y == y ? y : 0.0f;
+            y = y < -32768.0f ? -32768.0f : y > 32767.0f ? 32767.0f : y;
+            out[done + i] = (int16_t)floor_int(y + 0.5f);
+        }
+    }
+    return 1;
+}
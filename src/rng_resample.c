@@ -0,0 +1,174 @@
+#include "rng.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define RESAMPLE_CHUNK 65536  // elements per scan task, merge-path steps per merge task
+
+// the chunking is fixed, so sums and outputs do not depend on num_threads
+
+typedef struct {
+    const double* in;
+    double* out;
+    double* sums;   // per-chunk totals, then their exclusive scan
+    size_t n;
+    int pass;
+} scan_job_t;
+
+static void scan_task(rng_state_t* rng, size_t task, void* ctx) {
+    (void)rng;
+    scan_job_t* job = ctx;
+    size_t lo = task * RESAMPLE_CHUNK, hi = lo + RESAMPLE_CHUNK < job->n ? lo + RESAMPLE_CHUNK : job->n;
+    if (job->pass == 0) {
+        double s = 0.0;
+        for (size_t i = lo; i < hi; i++) s += job->in[i] > 0.0 ? job->in[i] : 0.0;
+        job->sums[task] = s;
+    } else {
+        double s = job->sums[task];
+        for (size_t i = lo; i < hi; i++) job->out[i] = s += job->in[i] > 0.0 ? job->in[i] : 0.0;
+    }
+}
+
+// inclusive prefix sum, negative and nan inputs counted as 0: chunk totals
+// in parallel, a serial scan over the totals, then the chunks in parallel
+static bool prefix_sum(const double* in, double* out, size_t n, int num_threads) {
+    size_t tasks = (n + RESAMPLE_CHUNK - 1) / RESAMPLE_CHUNK;
+    scan_job_t job = { in, out, malloc(tasks * sizeof(double)), n, 0 };
+    if (!job.sums) return 0;
+    bool ok = rng_run_tasks(RNG_XOSHIRO256PP, 1, NULL, tasks, num_threads, scan_task, &job);
+    double s = 0.0;
+    for (size_t t = 0; t < tasks; t++) {
+        double v = job.sums[t];
+        job.sums[t] = s;
+        s += v;
+    }
+    job.pass = 1;
+    ok = ok && rng_run_tasks(RNG_XOSHIRO256PP, 1, NULL, tasks, num_threads, scan_task, &job);
+    free(job.sums);
+    return ok;
+}
+
+// sorted resampling points: (j + u[j]) * scale, or (j + offset) * scale
+// when u is NULL (systematic)
+typedef struct {
+    const double* u;
+    double offset, scale;
+} points_t;
+
+static inline double point(const points_t* p, size_t j) {
+    return ((double)j + (p->u ? p->u[j] : p->offset)) * p->scale;
+}
+
+typedef struct {
+    const double* cdf;
+    size_t n;
+    points_t pts;
+    size_t m;
+    size_t last;    // last particle with positive weight, catches rounding past the end
+    size_t* out;
+} merge_job_t;
+
+// merge path: the point j belongs to the first particle i with cdf[i] >
+// point j, i.e. a merge of the two sorted sequences where cdf[i] <= point
+// goes first. corank finds how many cdf entries lie in the first d merged
+// elements, so each task starts mid-merge on an equal share of the path.
+static size_t corank(const merge_job_t* job, size_t d) {
+    size_t lo = d > job->m ? d - job->m : 0, hi = d < job->n ? d : job->n;
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (job->cdf[i] <= point(&job->pts, d - i - 1)) lo = i + 1;
+        else hi = i;
+    }
+    return lo;
+}
+
+static void merge_task(rng_state_t* rng, size_t task, void* ctx) {
+    (void)rng;
+    merge_job_t* job = ctx;
+    size_t total = job->n + job->m;
+    size_t d0 = task * RESAMPLE_CHUNK, d1 = d0 + RESAMPLE_CHUNK < total ? d0 + RESAMPLE_CHUNK : total;
+    size_t i = corank(job, d0), j = d0 - i, j1 = d1 - corank(job, d1);
+    while (j < j1) {
+        if (i < job->n && job->cdf[i] <= point(&job->pts, j)) i++;
+        else job->out[j++] = i < job->n ? i : job->last;
+    }
+}
+
+static bool merge(const double* cdf, size_t n, points_t pts, size_t m, size_t last, size_t* out,
+                  int num_threads) {
+    merge_job_t job = { cdf, n, pts, m, last, out };
+    size_t tasks = (n + m + RESAMPLE_CHUNK - 1) / RESAMPLE_CHUNK;
+    return rng_run_tasks(RNG_XOSHIRO256PP, 1, NULL, tasks, num_threads, merge_task, &job);
+}
+
+static size_t last_positive(const double* w, size_t n) {
+    size_t last = n - 1;
+    while (last && !(w[last] > 0.0)) last--;
+    return last;
+}
+
+// residual: floor(m w_i / W) copies of each particle, the remaining R slots
+// drawn systematically from the fractional parts. the counts go through
+// the same scan and merge to come out as sorted indices.
+static bool resample_residual(rng_state_t* state, const double* w, size_t n, double total,
+                              size_t* out, size_t m, int num_threads) {
+    double* frac = malloc(n * sizeof(double));
+    double* cnt = malloc(n * sizeof(double));
+    bool ok = frac && cnt;
+    size_t* extra = NULL;
+    if (ok) {
+        double k = (double)m / total, whole = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            double e = w[i] > 0.0 ? w[i] * k : 0.0, f = floor(e);
+            cnt[i] = f;
+            frac[i] = e - f;
+            whole += f;
+        }
+        size_t r = whole < (double)m ? m - (size_t)whole : 0;
+        if (r) {
+            extra = malloc(r * sizeof(size_t));
+            ok = extra && prefix_sum(frac, frac, n, num_threads);
+            if (ok) {
+                double rt = frac[n - 1];
+                points_t pts = { NULL, rng_next_double(state), rt / (double)r };
+                ok = rt > 0.0 && merge(frac, n, pts, r, last_positive(w, n), extra, num_threads);
+            }
+            for (size_t j = 0; ok && j < r; j++) cnt[extra[j]] += 1.0;
+        }
+        if (ok) {
+            points_t slots = { NULL, 0.5, 1.0 };
+            ok = prefix_sum(cnt, cnt, n, num_threads) &&
+                 merge(cnt, n, slots, m, last_positive(w, n), out, num_threads);
+        }
+    }
+    free(frac);
+    free(cnt);
+    free(extra);
+    return ok;
+}
+
+bool rng_resample(rng_state_t* state, rng_resample_kind_t kind, const double* weights, size_t n,
+                  size_t* out, size_t m, int num_threads) {
+    if (!state || !weights || !out || !n || kind > RNG_RESAMPLE_RESIDUAL) return 0;
+    if (!m) return 1;
+    double* cdf = malloc(n * sizeof(double));
+    double* u = NULL;
+    bool ok = cdf && prefix_sum(weights, cdf, n, num_threads);
+    double total = ok ? cdf[n - 1] : 0.0;
+    ok = ok && total > 0.0 && isfinite(total);
+    if (ok && kind == RNG_RESAMPLE_RESIDUAL) {
+        ok = resample_residual(state, weights, n, total, out, m, num_threads);
+    } else if (ok) {
+        points_t pts = { NULL, 0.0, total / (double)m };
+        if (kind == RNG_RESAMPLE_STRATIFIED) {
+            ok = (u = malloc(m * sizeof(double))) != NULL;
+            if (ok) rng_fill_double(state, u, m);
+            pts.u = u;
+        } else {
+            pts.offset = rng_next_double(state);
+        }
+        ok = ok && merge(cdf, n, pts, m, last_positive(weights, n), out, num_threads);
+    }
+    free(cdf);
+    free(u);
+    return ok;
+}
@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L
+#include "rng.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define CACHE_LINE 64
+#define TASK_KEY 0x7461736bULL  // "task", keeps task streams apart from other hash users
+
+// each worker owns a contiguous range of task ids. the owner pops from the
+// front, thieves split off the back half, so steals are rare and coarse.
+typedef struct {
+    pthread_mutex_t lock;
+    size_t lo, hi;
+} sched_deque_t;
+
+typedef struct {
+    sched_deque_t* deques;
+    size_t stride;          // bytes between deques, a whole number of cache lines
+    int num_workers;
+    rng_type_t type;
+    uint64_t seed;
+    rng_params_t* params;
+    rng_task_fn fn;
+    void* ctx;
+} sched_t;
+
+typedef struct {
+    sched_t* sched;
+    int id;
+    bool ok;
+} worker_arg_t;
+
+static sched_deque_t* deque_at(sched_t* s, int i) {
+    return (sched_deque_t*)((char*)s->deques + (size_t)i * s->stride);
+}
+
+static bool pop_own(sched_deque_t* d, size_t* task) {
+    bool got = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->lo < d->hi) {
+        *task = d->lo++;
+        got = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return got;
+}
+
+static bool steal(sched_t* s, int self, size_t* task) {
+    for (int k = 1; k < s->num_workers; k++) {
+        sched_deque_t* v = deque_at(s, (self + k) % s->num_workers);
+        size_t lo = 0, hi = 0;
+        pthread_mutex_lock(&v->lock);
+        if (v->lo < v->hi) {
+            size_t mid = v->lo + (v->hi - v->lo) / 2;
+            lo = mid; hi = v->hi;
+            v->hi = mid;
+        }
+        pthread_mutex_unlock(&v->lock);
+        if (lo < hi) {
+            sched_deque_t* d = deque_at(s, self);
+            *task = lo;
+            pthread_mutex_lock(&d->lock);
+            d->lo = lo + 1; d->hi = hi;
+            pthread_mutex_unlock(&d->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* worker_main(void* p) {
+    worker_arg_t* arg = p;
+    sched_t* s = arg->sched;
+    sched_deque_t* own = deque_at(s, arg->id);
+    rng_state_t* rng = rng_init(s->type, 1, s->params);
+    if (!rng) {
+        arg->ok = 0;
+        return NULL;
+    }
+    size_t task;
+    while (pop_own(own, &task) || steal(s, arg->id, &task)) {
+        // the stream depends only on (seed, task id), never on the worker;
+        // | 1 keeps it off seed 0, which rng_reseed maps to the clock
+        rng_reseed(rng, rng_hash_at(s->seed, TASK_KEY, task) | 1);
+        s->fn(rng, task, s->ctx);
+    }
+    rng_free(rng);
+    arg->ok = 1;
+    return NULL;
+}
+
+int rng_num_cpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+bool rng_run_tasks(rng_type_t type, uint64_t seed, rng_params_t* params, size_t num_tasks,
+                   int num_threads, rng_task_fn fn, void* ctx) {
+    if (!fn) return 0;
+    if (!num_tasks) return 1;
+    if (num_threads <= 0) num_threads = rng_num_cpus();
+    if ((size_t)num_threads > num_tasks) num_threads = (int)num_tasks;
+
+    sched_t s = { 0 };
+    s.stride = (sizeof(sched_deque_t) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    s.num_workers = num_threads;
+    s.type = type; s.seed = seed; s.params = params;
+    s.fn = fn; s.ctx = ctx;
+    void* mem = NULL;
+    if (posix_memalign(&mem, CACHE_LINE, s.stride * num_threads)) return 0;
+    s.deques = mem;
+    for (int i = 0; i < num_threads; i++) {
+        sched_deque_t* d = deque_at(&s, i);
+        pthread_mutex_init(&d->lock, NULL);
+        d->lo = num_tasks * i / num_threads;
+        d->hi = num_tasks * (i + 1) / num_threads;
+    }
+
+    worker_arg_t* args = calloc(num_threads, sizeof(worker_arg_t));
+    pthread_t* threads = calloc(num_threads, sizeof(pthread_t));
+    bool ok = args && threads;
+    int started = 1;
+    if (ok) {
+        for (int i = 0; i < num_threads; i++) {
+            args[i].sched = &s;
+            args[i].id = i;
+        }
+        // the caller is worker 0; if a thread fails to start the others steal its range
+        for (; started < num_threads; started++)
+            if (pthread_create(&threads[started], NULL, worker_main, &args[started])) break;
+        worker_main(&args[0]);
+        for (int i = 1; i < started; i++) pthread_join(threads[i], NULL);
+        for (int i = 0; i < started; i++) ok = ok && args[i].ok;
+    }
+
+    for (int i = 0; i < num_threads; i++) pthread_mutex_destroy(&deque_at(&s, i)->lock);
+    free(threads);
+    free(args);
+    free(mem);
+    return ok;
+}
@@ -0,0 +1,266 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  // syscall() for futex
+#include "rng.h"
+#include "rng_service.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define CACHE_LINE 64
+#define SVC_MAGIC 0x726e67736863ULL  // "rngshc"
+#define SVC_DEFAULT_BLOCK 4096
+#define SVC_DEFAULT_BLOCKS 1024
+
+// shared layout: header, one sequence word per slot (own cache line), data.
+// bounded mpmc ring (vyukov) with a single producer: slot i holding ticket p
+// has seq == p + 1; a consumer that wins the cas on tail copies the block
+// out and sets seq = p + num_blocks, handing the slot back to the producer.
+// a consumer that dies between its cas and the seq store never hands its
+// slot back: the producer stops there, and clients run on their local
+// engines until the producer is restarted.
+typedef struct {
+    uint64_t magic;        // written last, clients ignore a ring without it
+    uint64_t block_size;
+    uint64_t num_blocks;
+    uint64_t owner;        // producer pid, a ring whose owner is gone is stale
+    char pad0[CACHE_LINE - 32];
+    uint64_t head;         // producer's next ticket, for monitoring
+    char pad1[CACHE_LINE - 8];
+    uint64_t tail;         // next ticket to be claimed by a consumer
+    char pad2[CACHE_LINE - 8];
+    uint32_t freed;        // futex word, bumped by every claim
+    uint32_t waiting;      // producer is asleep on freed
+    char pad3[CACHE_LINE - 8];
+} svc_header_t;
+
+typedef struct {
+    uint64_t seq;
+    char pad[CACHE_LINE - 8];
+} svc_slot_t;
+
+struct rng_service {
+    char* name;
+    void* map;
+    size_t map_size;
+    svc_header_t* hdr;
+    svc_slot_t* slots;
+    uint8_t* data;
+    uint64_t head;
+    rng_state_t* rng;
+};
+
+// bytes for the whole ring, 0 if that does not fit in a size_t
+static size_t layout_size(uint64_t block_size, uint64_t num_blocks) {
+    uint64_t per = block_size + sizeof(svc_slot_t);
+    if (per < block_size || (num_blocks && per > (SIZE_MAX - sizeof(svc_header_t)) / num_blocks)) return 0;
+    return sizeof(svc_header_t) + (size_t)(num_blocks * per);
+}
+
+static svc_slot_t* slots_of(void* map) {
+    return (svc_slot_t*)((uint8_t*)map + sizeof(svc_header_t));
+}
+
+static uint8_t* data_of(void* map, size_t num_blocks) {
+    return (uint8_t*)map + sizeof(svc_header_t) + num_blocks * sizeof(svc_slot_t);
+}
+
+// a ring left behind by a producer that died without rng_service_free.
+// anything else under the name (a live producer, a half-written ring, some
+// other object) is not ours to remove.
+static bool ring_stale(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return 0;
+    struct stat st;
+    bool stale = 0;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(svc_header_t)) {
+        void* map = mmap(NULL, sizeof(svc_header_t), PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            const svc_header_t* hdr = map;
+            pid_t owner = (pid_t)hdr->owner;
+            stale = __atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == SVC_MAGIC && owner > 0 &&
+                    kill(owner, 0) != 0 && errno == ESRCH;
+            munmap(map, sizeof(svc_header_t));
+        }
+    }
+    close(fd);
+    return stale;
+}
+
+rng_service_t* rng_service_create(const char* name, rng_type_t type, uint64_t seed,
+                                  size_t block_size, size_t num_blocks) {
+    if (!name) return NULL;
+    if (!block_size) block_size = SVC_DEFAULT_BLOCK;
+    if (!num_blocks) num_blocks = SVC_DEFAULT_BLOCKS;
+    block_size = (block_size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+
+    rng_service_t* svc = calloc(1, sizeof(rng_service_t));
+    if (!svc) return NULL;
+    svc->rng = rng_init(type, seed, NULL);
+    svc->name = malloc(strlen(name) + 1);
+    if (!svc->rng || !svc->name) goto fail;
+    strcpy(svc->name, name);
+
+    svc->map_size = layout_size(block_size, num_blocks);
+    if (!svc->map_size) goto fail;
+    // owner only: anyone who can read the ring can read blocks before they
+    // are handed out. a ring from a dead producer is replaced, a live
+    // producer keeps its name and this create fails.
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST && ring_stale(name)) {
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (fd < 0) goto fail;
+    if (ftruncate(fd, (off_t)svc->map_size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        goto fail;
+    }
+    svc->map = mmap(NULL, svc->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (svc->map == MAP_FAILED) {
+        svc->map = NULL;
+        shm_unlink(name);
+        goto fail;
+    }
+    svc->hdr = svc->map;
+    svc->slots = slots_of(svc->map);
+    svc->data = data_of(svc->map, num_blocks);
+    svc->hdr->block_size = block_size;
+    svc->hdr->num_blocks = num_blocks;
+    svc->hdr->owner = (uint64_t)getpid();
+    for (size_t i = 0; i < num_blocks; i++) svc->slots[i].seq = i;
+    __atomic_store_n(&svc->hdr->magic, SVC_MAGIC, __ATOMIC_RELEASE);
+    return svc;
+
+fail:
+    rng_free(svc->rng);
+    free(svc->name);
+    free(svc);
+    return NULL;
+}
+
+size_t rng_service_pump(rng_service_t* svc) {
+    if (!svc) return 0;
+    size_t n = svc->hdr->num_blocks, bs = svc->hdr->block_size, made = 0;
+    for (;;) {
+        svc_slot_t* slot = &svc->slots[svc->head % n];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != svc->head) break;  // ring full
+        rng_fill_bytes(svc->rng, svc->data + (svc->head % n) * bs, bs);
+        __atomic_store_n(&slot->seq, svc->head + 1, __ATOMIC_RELEASE);
+        svc->head++;
+        made++;
+    }
+    __atomic_store_n(&svc->hdr->head, svc->head, __ATOMIC_RELAXED);
+    return made;
+}
+
+// sleeps until a consumer frees the slot the producer waits on, or
+// timeout_ms passes; 1 when pump has room again. the producer announces
+// itself in waiting before it reads freed, and consumers bump freed before
+// they read waiting, so either the consumer sees the flag and wakes it or
+// the futex sees freed changed and does not sleep.
+bool rng_service_wait(rng_service_t* svc, int timeout_ms) {
+    if (!svc) return 0;
+    svc_header_t* hdr = svc->hdr;
+    svc_slot_t* slot = &svc->slots[svc->head % hdr->num_blocks];
+    __atomic_store_n(&hdr->waiting, 1, __ATOMIC_SEQ_CST);
+    uint32_t freed = __atomic_load_n(&hdr->freed, __ATOMIC_SEQ_CST);
+    bool ready = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == svc->head;
+    if (!ready && timeout_ms > 0) {
+        struct timespec ts = { timeout_ms / 1000, timeout_ms % 1000 * 1000000L };
+#ifdef __linux__
+        syscall(SYS_futex, &hdr->freed, FUTEX_WAIT, freed, &ts, NULL, 0);
+#else
+        (void)freed;
+        nanosleep(&ts, NULL);
+#endif
+        ready = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == svc->head;
+    }
+    __atomic_store_n(&hdr->waiting, 0, __ATOMIC_RELAXED);
+    return ready;
+}
+
+void rng_service_free(rng_service_t* svc) {
+    if (!svc) return;
+    munmap(svc->map, svc->map_size);
+    shm_unlink(svc->name);
+    rng_free(svc->rng);
+    free(svc->name);
+    free(svc);
+}
+
+bool svc_client_open(svc_client_t* c, const char* name) {
+    memset(c, 0, sizeof(*c));
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(svc_header_t)) {
+        close(fd);
+        return 0;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+    // the header is only trusted once it describes a ring that fits the
+    // mapping: whole cache-line blocks, at least one of them, no overflow.
+    // the sizes are read once, so a later rewrite cannot move the bounds.
+    svc_header_t* hdr = map;
+    uint64_t bs = hdr->block_size, n = hdr->num_blocks;
+    size_t size = layout_size(bs, n);
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != SVC_MAGIC || !bs || bs % CACHE_LINE || !n ||
+        !size || size > (size_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return 0;
+    }
+    c->map = map;
+    c->map_size = (size_t)st.st_size;
+    c->block_size = (size_t)bs;
+    c->num_blocks = (size_t)n;
+    return 1;
+}
+
+void svc_client_close(svc_client_t* c) {
+    if (c->map) munmap(c->map, c->map_size);
+    c->map = NULL;
+}
+
+// claims the oldest published block into dst; 0 when the ring is empty
+bool svc_client_claim(svc_client_t* c, void* dst) {
+    if (!c->map) return 0;
+    svc_header_t* hdr = c->map;
+    svc_slot_t* slots = slots_of(c->map);
+    uint64_t n = c->num_blocks;
+    uint64_t pos = __atomic_load_n(&hdr->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        svc_slot_t* slot = &slots[pos % n];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&hdr->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                memcpy(dst, data_of(c->map, n) + (pos % n) * c->block_size, c->block_size);
+                __atomic_store_n(&slot->seq, pos + n, __ATOMIC_RELEASE);
+                __atomic_add_fetch(&hdr->freed, 1, __ATOMIC_SEQ_CST);
+#ifdef __linux__
+                if (__atomic_load_n(&hdr->waiting, __ATOMIC_SEQ_CST))
+                    syscall(SYS_futex, &hdr->freed, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&hdr->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef RNG_SERVICE_H
+#define RNG_SERVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// internal: client side of the shared-memory block ring, used by rng.c
+
+typedef struct {
+    void* map;
+    size_t map_size;
+    size_t block_size;
+    size_t num_blocks;
+} svc_client_t;
+
+bool svc_client_open(svc_client_t* c, const char* name);
+void svc_client_close(svc_client_t* c);
+bool svc_client_claim(svc_client_t* c, void* dst);
+
+#endif
@@ -0,0 +1,126 @@
+#define _POSIX_C_SOURCE 200809L
+#include "rng.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CACHE_LINE 64
+#define SHARD_KEY 0x7368617264ULL  // "shard"
+#define TLS_SLOTS 4
+
+// one shard per thread that has touched the handle. shards are only ever
+// pushed onto the list (lock-free cas), and freed with the handle; a shard
+// of a thread that exits is not reclaimed. the shard and the state it points
+// to (rng_init) each sit on cache lines of their own.
+typedef struct rng_shard {
+    struct rng_shard* next;
+    pthread_t owner;
+    rng_state_t* rng;
+} rng_shard_t;
+
+struct rng_shared {
+    uint64_t id;               // unique per handle, so stale tls entries never match
+    rng_type_t type;
+    uint64_t seed;
+    rng_params_t params;
+    bool has_params;
+    rng_shard_t* head;
+    uint64_t num_shards;
+};
+
+static uint64_t next_handle_id = 1;
+
+// small per-thread cache of (handle id -> state), the common path is one compare
+static __thread struct { uint64_t id; rng_state_t* rng; } tls_cache[TLS_SLOTS];
+
+rng_shared_t* rng_shared_init(rng_type_t type, uint64_t seed, rng_params_t* params) {
+    rng_state_t* probe = rng_init(type, seed ? seed : 1, params);
+    if (!probe) return NULL;
+    rng_free(probe);
+    rng_shared_t* h = calloc(1, sizeof(rng_shared_t));
+    if (!h) return NULL;
+    h->id = __atomic_fetch_add(&next_handle_id, 1, __ATOMIC_RELAXED);
+    h->type = type;
+    // seed 0 picks a clock seed once, so shards still get distinct keyed
+    // streams; seeding each shard from time() would repeat within a second
+    if (!seed) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        seed = rng_hash_key(rng_hash_key((uint64_t)ts.tv_sec, (uint64_t)ts.tv_nsec), h->id) | 1;
+    }
+    h->seed = seed;
+    if (params) {
+        h->params = *params;
+        h->has_params = 1;
+    }
+    return h;
+}
+
+void rng_shared_free(rng_shared_t* h) {
+    if (!h) return;
+    rng_shard_t* s = h->head;
+    while (s) {
+        rng_shard_t* next = s->next;
+        rng_free(s->rng);
+        free(s);
+        s = next;
+    }
+    free(h);
+}
+
+static rng_state_t* attach_shard(rng_shared_t* h) {
+    pthread_t self = pthread_self();
+    rng_shard_t* s = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    for (; s; s = s->next)
+        if (pthread_equal(s->owner, self)) return s->rng;
+
+    void* mem = NULL;
+    size_t size = (sizeof(rng_shard_t) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    if (posix_memalign(&mem, CACHE_LINE, size)) return NULL;
+    s = mem;
+    s->owner = self;
+    // shard k gets the keyed stream (seed, k); k is the order of first use
+    uint64_t k = __atomic_fetch_add(&h->num_shards, 1, __ATOMIC_RELAXED);
+    uint64_t seed = rng_hash_at(h->seed, SHARD_KEY, k) | 1;
+    s->rng = rng_init(h->type, seed, h->has_params ? &h->params : NULL);
+    if (!s->rng) {
+        free(s);
+        return NULL;
+    }
+    s->next = __atomic_load_n(&h->head, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&h->head, &s->next, s, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    return s->rng;
+}
+
+rng_state_t* rng_shared_local(rng_shared_t* h) {
+    if (!h) return NULL;
+    unsigned slot = (unsigned)(h->id % TLS_SLOTS);
+    if (tls_cache[slot].id == h->id) return tls_cache[slot].rng;
+    rng_state_t* rng = attach_shard(h);
+    if (rng) {
+        tls_cache[slot].id = h->id;
+        tls_cache[slot].rng = rng;
+    }
+    return rng;
+}
+
+uint32_t rng_shared_next_uint32(rng_shared_t* h) {
+    return rng_next_uint32(rng_shared_local(h));
+}
+
+uint64_t rng_shared_next_uint64(rng_shared_t* h) {
+    return rng_next_uint64(rng_shared_local(h));
+}
+
+double rng_shared_next_double(rng_shared_t* h) {
+    return rng_next_double(rng_shared_local(h));
+}
+
+double rng_shared_next_distribution(rng_shared_t* h) {
+    return rng_next_distribution(rng_shared_local(h));
+}
+
+bool rng_shared_fill_bytes(rng_shared_t* h, void* buffer, size_t size) {
+    return rng_fill_bytes(rng_shared_local(h), buffer, size);
+}
@@ -0,0 +1,254 @@
+#include "rng.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.14159265358979323846
+#define SKETCH_KEY 0x736b65746368ULL  // "sketch"
+#define SKETCH_TD 64                  // matrix rows per generated tile
+#define SKETCH_TK 128                 // matrix columns per tile, a multiple of 64
+#define SKETCH_TN SKETCH_TK           // data rows (apply) or columns (apply_left) per task
+#define SKETCH_DRAWS 16               // gap draws fetched at a time for sparse rows
+
+// the d x k matrix R is never stored. row i is the keyed stream
+// (seed, key(SKETCH_KEY, i)) indexed by column, so any tile can be rebuilt
+// in any order on any thread:
+//   gaussian    entries 2m, 2m + 1 are a box-muller pair from hashes 2m, 2m + 1
+//   rademacher  entry j is bit j & 63 of hash j >> 6
+//   achlioptas  per (row, column tile) stream of gap draws, so the cost
+//               follows the nonzeros rather than d * k
+// entries have variance 1 / k, so E |x R|^2 = |x|^2.
+struct rng_sketch {
+    rng_sketch_kind_t kind;
+    size_t d, k;
+    double density;   // share of nonzero entries
+    double value;     // magnitude of a nonzero (or rademacher) entry, normal sd
+    double log_q;     // log(1 - density), for the gaps
+    uint64_t seed;
+};
+
+rng_sketch_t* rng_sketch_create(rng_sketch_kind_t kind, size_t d, size_t k, double density,
+                                uint64_t seed) {
+    if (!d || !k || kind > RNG_SKETCH_ACHLIOPTAS) return NULL;
+    if (kind != RNG_SKETCH_ACHLIOPTAS) density = 1.0;
+    else if (density == 0.0) density = 1.0 / sqrt((double)d);
+    if (!(density > 0.0 && density <= 1.0)) return NULL;
+    rng_sketch_t* s = calloc(1, sizeof(rng_sketch_t));
+    if (!s) return NULL;
+    s->kind = kind;
+    s->d = d;
+    s->k = k;
+    s->density = density;
+    s->value = 1.0 / sqrt((double)k * density);
+    s->log_q = density < 1.0 ? log1p(-density) : -INFINITY;
+    s->seed = seed;
+    return s;
+}
+
+void rng_sketch_free(rng_sketch_t* s) {
+    free(s);
+}
+
+double rng_sketch_density(const rng_sketch_t* s) {
+    return s ? s->density : 0.0;
+}
+
+// one tile: rows [i0, i0 + td), columns [j0, j0 + tk). dense tiles are
+// td x tk row-major in val; sparse ones keep row ti's nonzeros at
+// [ptr[ti], ptr[ti + 1]) of col / val.
+typedef struct {
+    double* val;
+    uint64_t* bits;
+    unsigned short* col;
+    size_t ptr[SKETCH_TD + 1];
+} tile_t;
+
+static bool tile_alloc(tile_t* t) {
+    t->val = malloc(SKETCH_TD * SKETCH_TK * sizeof(double));
+    t->bits = malloc(SKETCH_TK * sizeof(uint64_t));
+    t->col = malloc(SKETCH_TD * SKETCH_TK * sizeof(unsigned short));
+    return t->val && t->bits && t->col;
+}
+
+static void tile_free(tile_t* t) {
+    free(t->val);
+    free(t->bits);
+    free(t->col);
+}
+
+static inline double unit_open(uint64_t h) {
+    return (double)((h >> 11) + 1) * 0x1.0p-53;  // (0, 1]
+}
+
+static void tile_gen(const rng_sketch_t* s, tile_t* t, size_t i0, size_t td, size_t j0, size_t tk) {
+    for (size_t ti = 0; ti < td; ti++) {
+        uint64_t key = rng_hash_key(SKETCH_KEY, i0 + ti);
+        double* row = t->val + ti * tk;
+        if (s->kind == RNG_SKETCH_GAUSSIAN) {
+            size_t pairs = (tk + 1) / 2;
+            rng_hash_fill(s->seed, key, j0, 2 * pairs, t->bits);
+            for (size_t m = 0; m < pairs; m++) {
+                double r = s->value * sqrt(-2.0 * log(unit_open(t->bits[2 * m])));
+                double a = 2.0 * PI * unit_open(t->bits[2 * m + 1]);
+                row[2 * m] = r * cos(a);
+                if (2 * m + 1 < tk) row[2 * m + 1] = r * sin(a);
+            }
+        } else if (s->kind == RNG_SKETCH_RADEMACHER) {
+            rng_hash_fill(s->seed, key, j0 / 64, (tk + 63) / 64, t->bits);
+            for (size_t j = 0; j < tk; j++)
+                row[j] = (t->bits[j / 64] >> (j & 63)) & 1 ? s->value : -s->value;
+        } else {
+            // gaps between nonzeros are geometric: floor(log u / log(1 - p))
+            size_t n = ti ? t->ptr[ti] : (t->ptr[0] = 0);
+            uint64_t skey = rng_hash_key(key, j0 / SKETCH_TK), draws = 0;
+            double j = -1.0;
+            for (;;) {
+                if (draws % SKETCH_DRAWS == 0) rng_hash_fill(s->seed, skey, draws, SKETCH_DRAWS, t->bits);
+                uint64_t h = t->bits[draws++ % SKETCH_DRAWS];
+                j += 1.0 + (s->density < 1.0 ? floor(log(unit_open(h)) / s->log_q) : 0.0);
+                if (j >= (double)tk) break;
+                t->col[n] = (unsigned short)j;
+                t->val[n++] = h & 1 ? s->value : -s->value;
+            }
+            t->ptr[ti + 1] = n;
+        }
+    }
+}
+
+// y[0..len) += a * x[0..len). full tile rows get a fixed trip count, which
+// the compiler vectorizes at -O2 where it leaves the variable one scalar.
+static inline void axpy(double* restrict y, double a, const double* restrict x, size_t len) {
+    if (len == SKETCH_TK) {
+        for (size_t i = 0; i < SKETCH_TK; i++) y[i] += a * x[i];
+        return;
+    }
+    for (size_t i = 0; i < len; i++) y[i] += a * x[i];
+}
+
+// four axpys sharing x, a full SKETCH_TK (= SKETCH_TN) row: each x value
+// is loaded once for all four outputs, quartering the reads of the tile
+// (apply) or of the data row (apply_left)
+static inline void axpy4(double* restrict y0, double* restrict y1, double* restrict y2,
+                         double* restrict y3, const double* v, const double* restrict x) {
+    for (size_t i = 0; i < SKETCH_TK; i++) {
+        double t = x[i];
+        y0[i] += v[0] * t;
+        y1[i] += v[1] * t;
+        y2[i] += v[2] * t;
+        y3[i] += v[3] * t;
+    }
+}
+
+typedef struct {
+    const rng_sketch_t* s;
+    const double* x;
+    double* y;
+    size_t n;        // rows of x (apply) or columns of a (apply_left)
+    bool left;
+    bool failed;
+} sketch_job_t;
+
+// task = (column tile of R, block of SKETCH_TN data rows / columns). the
+// output block is zeroed, then R is regenerated tile by tile down its d
+// rows and multiplied in; nothing but the output is written.
+static void sketch_task(rng_state_t* rng, size_t task, void* ctx) {
+    (void)rng;
+    sketch_job_t* job = ctx;
+    const rng_sketch_t* s = job->s;
+    const size_t d = s->d, k = s->k, kt = (k + SKETCH_TK - 1) / SKETCH_TK;
+    const bool sparse = s->kind == RNG_SKETCH_ACHLIOPTAS;
+    size_t j0 = task % kt * SKETCH_TK, tk = k - j0 < SKETCH_TK ? k - j0 : SKETCH_TK;
+    size_t r0 = task / kt * SKETCH_TN, rn = job->n - r0 < SKETCH_TN ? job->n - r0 : SKETCH_TN;
+    tile_t t;
+    if (!tile_alloc(&t)) {
+        tile_free(&t);
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (job->left)
+        for (size_t a = 0; a < tk; a++) memset(job->y + (j0 + a) * job->n + r0, 0, rn * sizeof(double));
+    else
+        for (size_t r = 0; r < rn; r++) memset(job->y + (r0 + r) * k + j0, 0, tk * sizeof(double));
+    for (size_t i0 = 0; i0 < d; i0 += SKETCH_TD) {
+        size_t td = d - i0 < SKETCH_TD ? d - i0 : SKETCH_TD;
+        tile_gen(s, &t, i0, td, j0, tk);
+        if (job->left) {
+            // y[j0 + a][r0..] += R[i][j0 + a] * a[i][r0..]
+            for (size_t ti = 0; ti < td; ti++) {
+                const double* ar = job->x + (i0 + ti) * job->n + r0;
+                double* y = job->y + j0 * job->n + r0;
+                size_t a = 0;
+                if (sparse)
+                    for (size_t e = t.ptr[ti]; e < t.ptr[ti + 1]; e++)
+                        axpy(y + t.col[e] * job->n, t.val[e], ar, rn);
+                else if (rn == SKETCH_TK)
+                    for (const size_t n = job->n; a + 4 <= tk; a += 4)
+                        axpy4(y + a * n, y + (a + 1) * n, y + (a + 2) * n, y + (a + 3) * n,
+                              t.val + ti * tk + a, ar);
+                for (; !sparse && a < tk; a++) axpy(y + a * job->n, t.val[ti * tk + a], ar, rn);
+            }
+        } else {
+            // y[r][j0..] += x[r][i] * R[i][j0..]
+            size_t r = 0;
+            if (!sparse && tk == SKETCH_TK)
+                for (; r + 4 <= rn; r += 4) {
+                    double* y = job->y + (r0 + r) * k + j0;
+                    const double* xr = job->x + (r0 + r) * d + i0;
+                    for (size_t ti = 0; ti < td; ti++) {
+                        double v[4] = { xr[ti], xr[d + ti], xr[2 * d + ti], xr[3 * d + ti] };
+                        axpy4(y, y + k, y + 2 * k, y + 3 * k, v, t.val + ti * tk);
+                    }
+                }
+            for (; r < rn; r++) {
+                const double* xr = job->x + (r0 + r) * d + i0;
+                double* y = job->y + (r0 + r) * k + j0;
+                for (size_t ti = 0; ti < td; ti++) {
+                    double v = xr[ti];
+                    if (v == 0.0) continue;
+                    if (sparse)
+                        for (size_t e = t.ptr[ti]; e < t.ptr[ti + 1]; e++) y[t.col[e]] += v * t.val[e];
+                    else
+                        axpy(y, v, t.val + ti * tk, tk);
+                }
+            }
+        }
+    }
+    tile_free(&t);
+}
+
+static bool sketch_run(const rng_sketch_t* s, const double* x, size_t n, double* y, bool left,
+                       int num_threads) {
+    if (!s || !x || !y) return 0;
+    if (!n) return 1;
+    sketch_job_t job = { s, x, y, n, left, 0 };
+    size_t tasks = (s->k + SKETCH_TK - 1) / SKETCH_TK * ((n + SKETCH_TN - 1) / SKETCH_TN);
+    return rng_run_tasks(RNG_XOSHIRO256PP, 1, NULL, tasks, num_threads, sketch_task, &job) && !job.failed;
+}
+
+bool rng_sketch_apply(const rng_sketch_t* s, const double* x, size_t n, double* y, int num_threads) {
+    return sketch_run(s, x, n, y, 0, num_threads);
+}
+
+bool rng_sketch_apply_left(const rng_sketch_t* s, const double* a, size_t m, double* y, int num_threads) {
+    return sketch_run(s, a, m, y, 1, num_threads);
+}
+
+bool rng_sketch_rows(const rng_sketch_t* s, size_t row0, size_t rows, double* out) {
+    if (!s || !out || row0 > s->d || rows > s->d - row0) return 0;
+    tile_t t;
+    bool ok = tile_alloc(&t);
+    for (size_t i = 0; ok && i < rows; i++)
+        for (size_t j0 = 0; j0 < s->k; j0 += SKETCH_TK) {
+            size_t tk = s->k - j0 < SKETCH_TK ? s->k - j0 : SKETCH_TK;
+            double* row = out + i * s->k + j0;
+            tile_gen(s, &t, row0 + i, 1, j0, tk);
+            if (s->kind != RNG_SKETCH_ACHLIOPTAS) {
+                memcpy(row, t.val, tk * sizeof(double));
+                continue;
+            }
+            memset(row, 0, tk * sizeof(double));
+            for (size_t e = 0; e < t.ptr[1]; e++) row[t.col[e]] = t.val[e];
+        }
+    tile_free(&t);
+    return ok;
+}
@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 200809L
+#include "rng.h"
+#include "rng_aes.h"
+#include "rng_dsfmt.h"
+#include "rng_tune.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define TUNE_X86 1
+#endif
+
+#define TUNE_VERSION 1
+#define TUNE_WORDS (1 << 18)  // 2 MB per trial, past l2 on most parts
+#define TUNE_REPS 3
+#define TUNE_SEED 12345
+
+typedef struct {
+    int aes;
+    int dsfmt;
+    size_t chunk;
+} tune_t;
+
+// cache entries are only reused on the same cpu model and feature set
+static void cpu_id(char* out, size_t len) {
+#ifdef TUNE_X86
+    unsigned a, b, c, d, vendor[3] = { 0 };
+    unsigned sig = 0, f1 = 0, f7 = 0;
+    if (__get_cpuid(0, &a, &b, &c, &d)) {
+        vendor[0] = b; vendor[1] = d; vendor[2] = c;
+    }
+    if (__get_cpuid(1, &a, &b, &c, &d)) {
+        sig = a;
+        f1 = c;
+    }
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d)) f7 = b;
+    char v[13];
+    memcpy(v, vendor, 12);
+    v[12] = 0;
+    for (int i = 0; i < 12; i++)
+        if (v[i] == ' ' || !v[i]) v[i] = '_';
+    snprintf(out, len, "%s-%08x-%08x-%08x", v, sig, f1, f7);
+#else
+    snprintf(out, len, "generic");
+#endif
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// $XDG_CACHE_HOME/rng-lib/autotune, or ~/.cache/rng-lib/autotune
+static bool cache_path(char* out, size_t len, bool create) {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    int w;
+    if (xdg && xdg[0] == '/') w = snprintf(out, len, "%s", xdg);
+    else if (home && home[0]) w = snprintf(out, len, "%s/.cache", home);
+    else return 0;
+    if (w < 0 || (size_t)w >= len) return 0;
+    if (create && mkdir(out, 0700) && errno != EEXIST) return 0;
+    size_t n = strlen(out);
+    w = snprintf(out + n, len - n, "/rng-lib");
+    if (w < 0 || (size_t)w >= len - n) return 0;
+    if (create && mkdir(out, 0700) && errno != EEXIST) return 0;
+    n = strlen(out);
+    w = snprintf(out + n, len - n, "/autotune");
+    return w >= 0 && (size_t)w < len - n;
+}
+
+static bool load(const char* cpu, tune_t* t) {
+    char path[512], id[128];
+    int version;
+    if (!cache_path(path, sizeof(path), 0)) return 0;
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+    bool ok = fscanf(f, "rng-autotune %d %127s aes %d dsfmt %d chunk %zu",
+                     &version, id, &t->aes, &t->dsfmt, &t->chunk) == 5;
+    fclose(f);
+    return ok && version == TUNE_VERSION && !strcmp(id, cpu) && t->aes >= 0 &&
+           t->aes <= aes_hw_available() && (t->dsfmt == 0 || t->dsfmt == 1) && t->chunk <= (1 << 24);
+}
+
+// written to a temporary name and renamed, so readers never see half a file
+static void save(const char* cpu, const tune_t* t) {
+    char path[512], tmp[560];
+    if (!cache_path(path, sizeof(path), 1)) return;
+    snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid());
+    FILE* f = fopen(tmp, "w");
+    if (!f) return;
+    int w = fprintf(f, "rng-autotune %d %s\naes %d\ndsfmt %d\nchunk %zu\n",
+                    TUNE_VERSION, cpu, t->aes, t->dsfmt, t->chunk);
+    if (fclose(f) || w < 0 || rename(tmp, path)) remove(tmp);
+}
+
+// best-of-n time for one candidate. the output of every candidate is
+// checked against the first one, a kernel that disagrees is never picked.
+static double trial(rng_type_t type, bool as_double, uint64_t* buf, uint64_t* ref) {
+    double best = -1;
+    for (int r = 0; r < TUNE_REPS; r++) {
+        rng_state_t* rng = rng_init(type, TUNE_SEED, NULL);
+        if (!rng) return -1;
+        double t0 = now();
+        if (as_double) rng_fill_double(rng, (double*)buf, TUNE_WORDS);
+        else rng_fill_bytes(rng, buf, TUNE_WORDS * sizeof(uint64_t));
+        double t = now() - t0;
+        rng_free(rng);
+        if (best < 0 || t < best) best = t;
+    }
+    if (ref != buf) {
+        if (memcmp(buf, ref, TUNE_WORDS * sizeof(uint64_t))) return -1;
+    }
+    return best;
+}
+
+static void calibrate(tune_t* t, uint64_t* buf, uint64_t* ref) {
+    double best, s;
+
+    // aes: portable, aes-ni, vaes; the reference run is the portable kernel
+    t->aes = 0;
+    aes_set_kernel(0);
+    best = trial(RNG_AES128CTR, 0, ref, ref);
+    for (int k = 1; k <= aes_hw_available(); k++) {
+        aes_set_kernel(k);
+        if ((s = trial(RNG_AES128CTR, 0, buf, ref)) >= 0 && s < best) {
+            best = s;
+            t->aes = k;
+        }
+    }
+    aes_set_kernel(t->aes);
+
+    // dsfmt: scalar vs sse2 recursion
+    t->dsfmt = 0;
+    dsfmt_set_kernel(0);
+    best = trial(RNG_DSFMT, 1, ref, ref);
+    dsfmt_set_kernel(1);
+    if (dsfmt_kernel_level() && (s = trial(RNG_DSFMT, 1, buf, ref)) >= 0 && s < best) t->dsfmt = 1;
+    dsfmt_set_kernel(t->dsfmt);
+
+    // rng_fill_double chunking, 0 = one pass
+    static const size_t chunks[] = { 256, 1024, 4096, 16384 };
+    t->chunk = 0;
+    rng_set_fill_chunk(0);
+    best = trial(RNG_XOSHIRO256PP, 1, ref, ref);
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        rng_set_fill_chunk(chunks[i]);
+        if ((s = trial(RNG_XOSHIRO256PP, 1, buf, ref)) >= 0 && s < best) {
+            best = s;
+            t->chunk = chunks[i];
+        }
+    }
+    rng_set_fill_chunk(t->chunk);
+}
+
+// picks the fastest stream-preserving kernels for this cpu, from the cache
+// when it matches, otherwise by timing each candidate and saving the result
+bool rng_autotune(void) {
+    char cpu[128];
+    tune_t t;
+    cpu_id(cpu, sizeof(cpu));
+    if (load(cpu, &t)) {
+        aes_set_kernel(t.aes);
+        dsfmt_set_kernel(t.dsfmt);
+        rng_set_fill_chunk(t.chunk);
+        return 1;
+    }
+    uint64_t* buf = malloc(2 * TUNE_WORDS * sizeof(uint64_t));
+    if (!buf) return 0;
+    calibrate(&t, buf, buf + TUNE_WORDS);
+    free(buf);
+    save(cpu, &t);
+    return 1;
+}
@@ -0,0 +1,12 @@
+#ifndef RNG_TUNE_H
+#define RNG_TUNE_H
+
+#include <stddef.h>
+
+// internal: knobs in rng.c the autotuner sets. none of them change any
+// stream, only how the work is split up.
+
+void rng_set_fill_chunk(size_t words);  // rng_fill_double words per pass, 0 = no chunking
+size_t rng_fill_chunk(void);
+
+#endif
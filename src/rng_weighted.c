@@ -0,0 +1,121 @@
+#include "rng.h"
+#include <math.h>
+#include <stdlib.h>
+
+// fenwick tree over the weights: update and sample are o(log n). updates
+// apply deltas, so rounding drifts over time; the tree is rebuilt from the
+// exact weights every n updates, o(1) amortized.
+struct rng_weighted {
+    size_t n, top;        // top = highest power of two <= n
+    double* w;            // current weights, exact
+    double* tree;         // 1-based fenwick sums
+    size_t nonzero;
+    size_t updates;
+};
+
+static void rebuild(rng_weighted_t* t) {
+    for (size_t i = 1; i <= t->n; i++) t->tree[i] = t->w[i - 1];
+    for (size_t i = 1; i <= t->n; i++) {
+        size_t parent = i + (i & -i);
+        if (parent <= t->n) t->tree[parent] += t->tree[i];
+    }
+    t->updates = 0;
+}
+
+rng_weighted_t* rng_weighted_create(size_t n, const double* weights) {
+    if (!n) return NULL;
+    rng_weighted_t* t = calloc(1, sizeof(rng_weighted_t));
+    if (!t) return NULL;
+    t->n = n;
+    t->w = calloc(n, sizeof(double));
+    t->tree = calloc(n + 1, sizeof(double));
+    if (!t->w || !t->tree) {
+        rng_weighted_free(t);
+        return NULL;
+    }
+    for (t->top = 1; t->top * 2 <= n; t->top *= 2)
+        ;
+    double total = 0.0;
+    for (size_t i = 0; weights && i < n; i++) {
+        double w = weights[i];
+        t->w[i] = w > 0.0 ? w : 0.0;  // negative and nan weights count as 0
+        t->nonzero += t->w[i] > 0.0;
+        total += t->w[i];
+    }
+    // an infinite weight or total leaves nothing to sample in proportion to
+    if (!isfinite(total)) {
+        rng_weighted_free(t);
+        return NULL;
+    }
+    rebuild(t);
+    return t;
+}
+
+void rng_weighted_free(rng_weighted_t* t) {
+    if (!t) return;
+    free(t->w);
+    free(t->tree);
+    free(t);
+}
+
+bool rng_weighted_update(rng_weighted_t* t, size_t i, double w) {
+    if (!t || i >= t->n || !(w >= 0.0) || !isfinite(w)) return 0;
+    double delta = w - t->w[i];
+    if (!isfinite(rng_weighted_total(t) + delta)) return 0;
+    t->nonzero += (w > 0.0) - (t->w[i] > 0.0);
+    t->w[i] = w;
+    if (++t->updates >= t->n) {
+        rebuild(t);
+        return 1;
+    }
+    for (size_t k = i + 1; k <= t->n; k += k & -k) t->tree[k] += delta;
+    return 1;
+}
+
+double rng_weighted_get(const rng_weighted_t* t, size_t i) {
+    return t && i < t->n ? t->w[i] : 0.0;
+}
+
+double rng_weighted_total(const rng_weighted_t* t) {
+    if (!t) return 0.0;
+    double s = 0.0;
+    for (size_t k = t->n; k; k -= k & -k) s += t->tree[k];
+    return s;
+}
+
+// exact linear scan, only reached when the tree keeps missing (a lone
+// weight below the accumulated rounding error). a draw that rounding
+// carries past the end goes to the last positive weight.
+static size_t sample_linear(const rng_weighted_t* t, rng_state_t* rng) {
+    double total = 0.0;
+    size_t last = 0;
+    for (size_t i = 0; i < t->n; i++) {
+        total += t->w[i];
+        if (t->w[i] > 0.0) last = i;
+    }
+    double u = rng_next_double(rng) * total;
+    for (size_t i = 0; i < t->n; i++) {
+        if (u < t->w[i]) return i;
+        u -= t->w[i];
+    }
+    return last;
+}
+
+// index i with probability w[i] / total, SIZE_MAX when every weight is 0.
+// a draw that rounding lands on a zero weight (or past the end) is redrawn.
+size_t rng_weighted_sample(const rng_weighted_t* t, rng_state_t* rng) {
+    if (!t || !rng || !t->nonzero) return SIZE_MAX;
+    double total = rng_weighted_total(t);
+    for (int tries = 0; tries < 64; tries++) {
+        double u = rng_next_double(rng) * total;
+        size_t pos = 0;
+        for (size_t step = t->top; step; step >>= 1) {
+            if (pos + step <= t->n && t->tree[pos + step] <= u) {
+                pos += step;
+                u -= t->tree[pos];
+            }
+        }
+        if (pos < t->n && t->w[pos] > 0.0) return pos;
+    }
+    return sample_linear(t, rng);
+}
@@ -0,0 +1,36 @@
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/rng.h"
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+int main(int argc, char** argv) {
+    const char* name = (argc > 1) ? argv[1] : "/rng-service";
+    uint64_t seed = (argc > 2) ? strtoull(argv[2], 0, 10) : 0;
+    size_t blocks = (argc > 3) ? strtoull(argv[3], 0, 10) : 0;
+
+    rng_service_t* svc = rng_service_create(name, RNG_AES128CTR, seed, 0, blocks);
+    if (!svc) {
+        fprintf(stderr, "rngd: cannot create %s\n", name);
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("rngd: serving %s\n", name);
+    fflush(stdout);
+
+    // sleep on the ring while it is full; the timeout only bounds how long
+    // a signal can go unnoticed
+    while (!stop) {
+        if (!rng_service_pump(svc)) rng_service_wait(svc, 100);
+    }
+    rng_service_free(svc);
+    return 0;
+}
@@ -1,14 +1,51 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  // syscall() for perf_event_open
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <time.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
 #include "../include/rng.h"
+#include "../src/rng_aes.h"    // kernel levels for the aes known-answer test and benches
+#include "../src/rng_dsfmt.h"
 
 #define SAMPLE_SIZE 100000
 #define BINS 20
 
 void test_uniform(rng_state_t* state);
 void test_gaussian(rng_state_t* state);
+void test_hash(uint64_t seed);
+void test_gamma(rng_state_t* state, double shape, double scale);
+void print_stats(rng_state_t* state);
+void test_engines(uint64_t seed);
+void test_tasks(uint64_t seed);
+void test_shared(uint64_t seed);
+void test_service(uint64_t seed);
+void test_autotune(uint64_t seed);
+void test_blocks(uint64_t seed);
+void test_pipeline(uint64_t seed);
+void test_quant(uint64_t seed);
+void test_reservoir(uint64_t seed);
+void test_lfsr(uint64_t seed);
+void test_fault(uint64_t seed);
+void test_weighted(uint64_t seed);
+void test_trunc_normal(uint64_t seed);
+void test_is(uint64_t seed);
+void test_mcmc(uint64_t seed);
+void test_resample(uint64_t seed);
+void test_field(uint64_t seed);
+void test_arma(uint64_t seed);
+void test_sketch(uint64_t seed);
 void test_speed();
 void print_hist(double* bins, int num_bins);
 
@@ -35,6 +72,74 @@ int main(int argc, char** argv) {
 
     printf("\nTesting gaussian dist:\n");
     test_gaussian(gaussian);
+    print_stats(gaussian);
+
+    rng_params_t gparams = { .gamma = {2.0, 1.0} };
+    rng_state_t* gamma = rng_init(RNG_GAMMA, seed, &gparams);
+    printf("\nTesting gamma dist:\n");
+    test_gamma(gamma, 2.0, 1.0);
+    print_stats(gamma);
+    rng_free(gamma);
+
+    printf("\nTesting keyed hash:\n");
+    test_hash(seed);
+
+    printf("\nTesting engines:\n");
+    test_engines(seed);
+
+    printf("\nTesting block streaming:\n");
+    test_blocks(seed);
+
+    printf("\nTesting pipeline:\n");
+    test_pipeline(seed);
+
+    printf("\nTesting stochastic rounding:\n");
+    test_quant(seed);
+
+    printf("\nTesting bit reservoir:\n");
+    test_reservoir(seed);
+
+    printf("\nTesting PRBS / LFSR:\n");
+    test_lfsr(seed);
+
+    printf("\nTesting fault injection:\n");
+    test_fault(seed);
+
+    printf("\nTesting weighted sampler:\n");
+    test_weighted(seed);
+
+    printf("\nTesting truncated normal:\n");
+    test_trunc_normal(seed);
+
+    printf("\nTesting importance sampling:\n");
+    test_is(seed);
+
+    printf("\nTesting MCMC:\n");
+    test_mcmc(seed);
+
+    printf("\nTesting resampling:\n");
+    test_resample(seed);
+
+    printf("\nTesting random fields:\n");
+    test_field(seed);
+
+    printf("\nTesting ARMA series:\n");
+    test_arma(seed);
+
+    printf("\nTesting sketch operator:\n");
+    test_sketch(seed);
+
+    printf("\nTesting task runner:\n");
+    test_tasks(seed);
+
+    printf("\nTesting shared handle:\n");
+    test_shared(seed);
+
+    printf("\nTesting block service:\n");
+    test_service(seed);
+
+    printf("\nTesting autotune:\n");
+    test_autotune(seed);
 
     printf("\nTesting speed:\n");
     test_speed();
@@ -118,26 +223,1848 @@ void test_gaussian(rng_state_t* state) {
     free(samples);
 }
 
+void test_gamma(rng_state_t* state, double shape, double scale) {
+    double mean = 0, sq = 0;
+    for (int i = 0; i < SAMPLE_SIZE; i++) {
+        double x = rng_next_distribution(state);
+        mean += x; sq += x * x;
+    }
+    mean /= SAMPLE_SIZE;
+    printf("  Mean: %f (exp %.4f)\n", mean, shape * scale);
+    printf("  Var: %f (exp %.4f)\n", sq / SAMPLE_SIZE - mean * mean, shape * scale * scale);
+}
+
+void print_stats(rng_state_t* state) {
+    rng_stats_t st;
+    if (!rng_stats(state, &st)) {
+        printf("  Stats: not built (make STATS=1)\n");
+        return;
+    }
+    printf("  Stats: %llu samples, %.3f draws/sample, %.4f rejections/sample, %llu cache hits\n",
+           (unsigned long long)st.samples, (double)st.draws / st.samples,
+           (double)st.rejections / st.samples, (unsigned long long)st.cache_hits);
+}
+
+void test_hash(uint64_t seed) {
+    uint64_t* vals = malloc(SAMPLE_SIZE * sizeof(uint64_t));
+    uint64_t key = rng_hash_key(rng_hash_key(0, 3), 7);
+    double mean = 0, var = 0;
+    int i, mismatch = 0;
+
+    rng_hash_fill(seed, key, 1000, SAMPLE_SIZE, vals);
+    for (i = 0; i < SAMPLE_SIZE; i++) {
+        if (vals[i] != rng_hash_at(seed, key, 1000 + i)) mismatch++;
+        mean += (double)(vals[i] >> 11) * (1.0/9007199254740992.0);
+    }
+    mean /= SAMPLE_SIZE;
+    for (i = 0; i < SAMPLE_SIZE; i++) {
+        double d = (double)(vals[i] >> 11) * (1.0/9007199254740992.0) - mean;
+        var += d * d;
+    }
+    var /= SAMPLE_SIZE - 1;
+
+    printf("  Fill vs at mismatches: %d (exp 0)\n", mismatch);
+    printf("  Mean: %f (exp 0.5)\n", mean);
+    printf("  Var: %f (exp 0.0833)\n", var);
+    printf("  Neighbour keys differ: %s\n",
+           rng_hash_at(seed, rng_hash_key(0, 1), 0) != rng_hash_at(seed, rng_hash_key(0, 2), 0) ? "yes" : "no");
+    free(vals);
+}
+
+static const struct { rng_type_t type; const char* name; } engines[] = {
+    { RNG_XOSHIRO256PP, "Xoshiro" },
+    { RNG_XOSHIRO256P, "Xoshiro256+" },
+    { RNG_XOROSHIRO128P, "Xoroshiro128+" },
+    { RNG_SFC64, "SFC64" },
+    { RNG_WYRAND, "WyRand" },
+    { RNG_ROMUTRIO, "RomuTrio" },
+    { RNG_AES128CTR, "AES128-CTR" },
+    { RNG_ARS5, "ARS-5" },
+    { RNG_DSFMT, "dSFMT" },
+    { RNG_PCG32, "PCG32" },
+    { RNG_LFSR, "PRBS31" },
+};
+#define NUM_ENGINES (int)(sizeof(engines) / sizeof(engines[0]))
+
+void test_engines(uint64_t seed) {
+    for (int e = 0; e < NUM_ENGINES; e++) {
+        rng_state_t* rng = rng_init(engines[e].type, seed, 0);
+        double mean = 0, sq = 0;
+        for (int i = 0; i < SAMPLE_SIZE; i++) {
+            double x = rng_next_double(rng);
+            mean += x; sq += x * x;
+        }
+        mean /= SAMPLE_SIZE;
+        double var = sq / SAMPLE_SIZE - mean * mean;
+        printf("  %-14s mean %f var %f jump %s\n", engines[e].name, mean, var,
+               rng_jump(rng) ? "yes" : "no");
+        rng_free(rng);
+    }
+
+    // fips-197 appendix c.1: 00112233..ff under key 00010203..0f, through
+    // the portable kernel and every hardware level this cpu has. the block
+    // is the counter, so it goes in as ctr; 16 blocks reach the vaes path.
+    static const uint8_t kat[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+                                     0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+    static const char* levels[] = { "portable", "AES-NI", "VAES" };
+    uint8_t kat_ref[16 * 16], kat_out[16 * 16];
+    int saved = aes_kernel_level();
+    printf("  AES-128 FIPS-197 vector:");
+    for (int level = 0; level <= 2; level++) {
+        if (level > aes_hw_available()) {
+            printf(" %s n/a", levels[level]);
+            continue;
+        }
+        aes_ctr_t x;
+        aes_set_kernel(level);
+        aes_ctr_seed(&x, 0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL, 0);
+        x.ctr[0] = 0x7766554433221100ULL;
+        x.ctr[1] = 0xffeeddccbbaa9988ULL;
+        aes_ctr_blocks(&x, level ? kat_out : kat_ref, 16);
+        bool ok = memcmp(level ? kat_out : kat_ref, kat, 16) == 0 &&
+                  (!level || memcmp(kat_out, kat_ref, sizeof(kat_ref)) == 0);
+        printf(" %s %s", levels[level], ok ? "yes" : "no");
+    }
+    printf("\n");
+    aes_set_kernel(saved);
+
+    // non-temporal fills must give the same bytes as cached ones, aligned or
+    // not, down to sizes below two words, and must not write past the end
+    enum { NT_BYTES = 8 * 10007 + 5 };
+    static const size_t nt_sizes[] = { 1, 5, 8, 13, 16, 17, 24, NT_BYTES };
+    static uint64_t a[NT_BYTES / 8 + 2], b[NT_BYTES / 8 + 2];
+    bool same = 1;
+    for (int e = 0; e < NUM_ENGINES; e++) {
+        for (size_t k = 0; k < sizeof(nt_sizes) / sizeof(nt_sizes[0]); k++) {
+            size_t bytes = nt_sizes[k], doubles = bytes < 999 ? bytes : 999;
+            for (int off = 0; off < 2; off++) {
+                rng_state_t* x = rng_init(engines[e].type, seed, 0);
+                rng_state_t* y = rng_init(engines[e].type, seed, 0);
+                memset(a, 0xaa, sizeof(a));
+                memset(b, 0xaa, sizeof(b));
+                rng_set_nt_threshold(SIZE_MAX);
+                rng_fill_bytes(x, a + off, bytes);
+                rng_fill_double(x, (double*)a + off, doubles);
+                rng_set_nt_threshold(1);
+                rng_fill_bytes(y, b + off, bytes);
+                rng_fill_double(y, (double*)b + off, doubles);
+                size_t end = off * 8 + (bytes > 8 * doubles ? bytes : 8 * doubles);
+                same = same && memcmp(a, b, sizeof(a)) == 0 && ((uint8_t*)b)[end] == 0xaa &&
+                       rng_next_uint64(x) == rng_next_uint64(y);
+                rng_free(x);
+                rng_free(y);
+            }
+        }
+    }
+    rng_set_nt_threshold(0);
+    printf("  Streaming fills match cached fills: %s\n", same ? "yes" : "no");
+}
+
+typedef struct {
+    uint64_t* out;
+    size_t pos, blocks, stop_after;
+} collect_t;
+
+static bool collect_block(void* block, size_t n, void* ctx) {
+    collect_t* c = ctx;
+    memcpy(c->out + c->pos, block, n * 8);
+    c->pos += n;
+    return ++c->blocks != c->stop_after;
+}
+
+void test_blocks(uint64_t seed) {
+    enum { N = 100003 };
+    static uint64_t a[N], b[N];
+    rng_params_t gp = { .gaussian = {1.0, 2.0} }, kp = { .gamma = {0.7, 1.0} };
+    struct { rng_type_t type; rng_params_t* params; rng_block_kind_t kind; const char* name; } cases[] = {
+        { RNG_XOSHIRO256PP, 0, RNG_BLOCK_UINT64, "Xoshiro uint64" },
+        { RNG_AES128CTR, 0, RNG_BLOCK_UINT64, "AES128-CTR uint64" },
+        { RNG_DSFMT, 0, RNG_BLOCK_DOUBLE, "dSFMT double" },
+        { RNG_GAUSSIAN, &gp, RNG_BLOCK_DISTRIBUTION, "Gaussian" },
+        { RNG_GAMMA, &kp, RNG_BLOCK_DISTRIBUTION, "Gamma k=0.7" },
+    };
+    for (int c = 0; c < 5; c++) {
+        rng_state_t* x = rng_init(cases[c].type, seed, cases[c].params);
+        rng_state_t* y = rng_init(cases[c].type, seed, cases[c].params);
+        // odd sizes so blocks split gaussian pairs and engine buffers
+        collect_t col = { a, 0, 0, 0 };
+        rng_next_distribution(x);
+        bool done = rng_stream_blocks(x, cases[c].kind, N, 999, collect_block, &col);
+        rng_next_distribution(y);
+        for (size_t i = 0; i < N; i++) {
+            if (cases[c].kind == RNG_BLOCK_UINT64) b[i] = rng_next_uint64(y);
+            else {
+                double v = cases[c].kind == RNG_BLOCK_DOUBLE ? rng_next_double(y) : rng_next_distribution(y);
+                memcpy(&b[i], &v, 8);
+            }
+        }
+        bool same = done && col.pos == N && memcmp(a, b, sizeof(a)) == 0 &&
+                    rng_next_uint64(x) == rng_next_uint64(y);
+        printf("  %-18s matches per-call stream: %s\n", cases[c].name, same ? "yes" : "no");
+        rng_free(x);
+        rng_free(y);
+    }
+    rng_state_t* x = rng_init(RNG_XOSHIRO256PP, seed, 0);
+    collect_t col = { a, 0, 0, 3 };
+    bool done = rng_stream_blocks(x, RNG_BLOCK_DOUBLE, N, 0, collect_block, &col);
+    printf("  Early stop after 3 blocks: %s (%zu values)\n", !done && col.blocks == 3 ? "yes" : "no", col.pos);
+    rng_free(x);
+}
+
+static double clampd(double x, double lo, double hi) {
+    return x < lo ? lo : x > hi ? hi : x;
+}
+
+// the five-stage noise chain used by the test and the benchmark
+static rng_pipeline_t* noise_chain(uint64_t seed) {
+    rng_pipeline_t* p = rng_pipeline_create(RNG_XOSHIRO256PP, seed);
+    rng_pipeline_add_gaussian(p, 0.0, 1.0);
+    rng_pipeline_add_scale(p, 3.0, 1.0);
+    rng_pipeline_add_clamp(p, -4.0, 6.0);
+    rng_pipeline_add_scale(p, 0.5, -0.25);
+    rng_pipeline_add_quantize_int16(p, 1000.0);
+    return p;
+}
+
+void test_pipeline(uint64_t seed) {
+    enum { N = 100003 };
+    static double z[N], d[N];
+    static int16_t q[N], q2[N];
+
+    // fused chain against the same normals run through each stage by hand
+    rng_pipeline_t* src = rng_pipeline_create(RNG_XOSHIRO256PP, seed);
+    rng_pipeline_add_gaussian(src, 0.0, 1.0);
+    rng_pipeline_run(src, z, N);
+    rng_pipeline_t* p = noise_chain(seed);
+    rng_pipeline_run(p, q, N);
+    int maxdiff = 0;
+    double mean = 0;
+    for (int i = 0; i < N; i++) {
+        double y = clampd(3.0 * z[i] + 1.0, -4.0, 6.0) * 0.5 - 0.25;
+        int ref = (int)nearbyint(clampd(y * 1000.0, -32768.0, 32767.0));
+        int diff = abs(ref - q[i]);
+        if (diff > maxdiff) maxdiff = diff;
+        mean += q[i];
+    }
+    printf("  Gaussian chain int16 mean %.1f (exp ~250), max diff vs staged %d (exp <= 1)\n", mean / N, maxdiff);
+    rng_pipeline_free(p);
+
+    // same values whatever the call sizes
+    p = noise_chain(seed);
+    for (size_t done = 0, m = 1; done < N; done += m, m = m * 3 + 1)
+        rng_pipeline_run(p, q2 + done, done + m > N ? N - done : m);
+    printf("  Split runs match one run: %s\n", memcmp(q, q2, sizeof(q)) == 0 ? "yes" : "no");
+    rng_pipeline_free(p);
+
+    // uniform chain, negative scale after a clamp swaps the bounds
+    rng_pipeline_t* u = rng_pipeline_create(RNG_SFC64, seed);
+    rng_state_t* ref = rng_init(RNG_SFC64, seed, 0);
+    rng_pipeline_add_uniform(u, -1.0, 1.0);
+    rng_pipeline_add_clamp(u, -0.5, 0.8);
+    rng_pipeline_add_scale(u, -2.0, 0.1);
+    rng_pipeline_run(u, d, N);
+    double err = 0;
+    for (int i = 0; i < N; i++) {
+        double x = -2.0 * clampd(rng_next_double(ref) * 2.0 - 1.0, -0.5, 0.8) + 0.1;
+        if (fabs(x - d[i]) > err) err = fabs(x - d[i]);
+    }
+    printf("  Uniform chain max error %.2e (exp < 1e-12)\n", err);
+    printf("  Stage after quantize rejected: %s\n",
+           !rng_pipeline_add_scale(src, 1.0, 0.0) || !rng_pipeline_add_quantize_int16(src, 1.0) ||
+           !rng_pipeline_add_scale(src, 1.0, 0.0) ? "yes" : "no");
+    rng_free(ref);
+    rng_pipeline_free(u);
+    rng_pipeline_free(src);
+}
+
+static float bf16_to_float(uint16_t h) {
+    uint32_t b = (uint32_t)h << 16;
+    float x;
+    memcpy(&x, &b, 4);
+    return x;
+}
+
+static float fp16_to_float(uint16_t h) {
+    int e = (h >> 10) & 0x1f, m = h & 0x3ff;
+    float x = e ? ldexpf((float)(m | 0x400), e - 25) : ldexpf((float)m, -24);
+    if (e == 31) x = m ? NAN : INFINITY;
+    return h & 0x8000 ? -x : x;
+}
+
+// a constant input between two grid points must average back to itself
+void test_quant(uint64_t seed) {
+    enum { N = 200000 };
+    static float in[N];
+    static uint16_t h[N];
+    static int8_t q8[N];
+    static int16_t q16[N];
+    rng_state_t* rng = rng_init(RNG_XOSHIRO256PP, seed, 0);
+    const float bf = 1.0f + 0x1p-9f, fh = -(1.0f + 0x1p-12f), sub = 0.3f * 0x1p-24f;
+    const float vals[] = { bf, fh, sub };
+    for (int t = 0; t < 3; t++) {
+        for (int i = 0; i < N; i++) in[i] = vals[t];
+        if (t == 0) rng_round_bf16(rng, in, h, N);
+        else rng_round_fp16(rng, in, h, N);
+        double mean = 0;
+        for (int i = 0; i < N; i++) mean += t == 0 ? bf16_to_float(h[i]) : fp16_to_float(h[i]);
+        mean /= N;
+        const char* name[] = { "bf16 1+2^-9", "fp16 -(1+2^-12)", "fp16 0.3*2^-24" };
+        printf("  %-16s mean rel err %.5f (exp ~0)\n", name[t], (mean - vals[t]) / vals[t]);
+    }
+
+    for (int i = 0; i < N; i++) in[i] = -2.3f;
+    rng_round_int8(rng, in, q8, N, 1.0f);
+    double m8 = 0;
+    for (int i = 0; i < N; i++) m8 += q8[i];
+    rng_dither_int16(rng, in, q16, N, 10.0f);
+    double m16 = 0, v16 = 0;
+    for (int i = 0; i < N; i++) {
+        m16 += q16[i];
+        v16 += (q16[i] + 23.0) * (q16[i] + 23.0);
+    }
+    printf("  int8 -2.3: mean %f, dither -23.0: mean %f var %f (exp 0.25)\n", m8 / N, m16 / N, v16 / N);
+
+    // specials: inf, nan, overflow and saturation
+    float sp[] = { INFINITY, -INFINITY, NAN, 70000.0f, 1e30f, 1e-30f, 0.0f };
+    uint16_t hb[7], hh[7];
+    int8_t s8[7];
+    rng_round_bf16(rng, sp, hb, 7);
+    rng_round_fp16(rng, sp, hh, 7);
+    rng_round_int8(rng, sp, s8, 7, 1.0f);
+    bool ok = hb[0] == 0x7f80 && hb[1] == 0xff80 && (hb[2] & 0x7fff) > 0x7f80 &&
+              hh[0] == 0x7c00 && hh[1] == 0xfc00 && (hh[2] & 0x7fff) > 0x7c00 && hh[3] == 0x7c00 &&
+              hh[4] == 0x7c00 && hh[5] <= 1 && hh[6] == 0 &&
+              s8[0] == 127 && s8[1] == -128 && s8[2] == 0 && s8[4] == 127 && s8[6] == 0;
+    printf("  Specials handled: %s\n", ok ? "yes" : "no");
+    rng_free(rng);
+}
+
+void test_reservoir(uint64_t seed) {
+    // documented layout: narrow draws take the top bits of one engine word
+    rng_state_t* a = rng_init(RNG_XOSHIRO256PP, seed, 0);
+    rng_state_t* b = rng_init(RNG_XOSHIRO256PP, seed, 0);
+    uint64_t w0 = rng_next_uint64(b), w1 = rng_next_uint64(b), w2 = rng_next_uint64(b);
+    bool same = rng_next_uint32(a) == (uint32_t)(w0 >> 32) && rng_next_uint32(a) == (uint32_t)w0;
+    for (int k = 0; k < 8; k++) same = same && rng_next_uint8(a) == (uint8_t)(w1 >> (56 - 8 * k));
+    uint8_t tail[13];
+    rng_fill_bytes(a, tail, 13);  // the whole word is w2, the tail the low bytes of the next
+    same = same && memcmp(tail, &w2, 8) == 0;
+    uint64_t w3 = rng_next_uint64(b);
+    same = same && memcmp(tail + 8, &w3, 5) == 0;
+    printf("  Xoshiro narrow draws match word layout: %s\n", same ? "yes" : "no");
+    rng_free(a);
+    rng_free(b);
+
+    // fill_bytes(n) is a prefix of fill_bytes(n + k) for every engine
+    static const size_t sizes[] = { 1, 3, 7, 8, 9, 13, 21, 64 };
+    uint8_t shorter[64], longer[64];
+    same = 1;
+    for (int e = 0; e < NUM_ENGINES; e++)
+        for (size_t k = 0; k + 1 < sizeof(sizes) / sizeof(sizes[0]); k++) {
+            a = rng_init(engines[e].type, seed, 0);
+            b = rng_init(engines[e].type, seed, 0);
+            rng_fill_bytes(a, shorter, sizes[k]);
+            rng_fill_bytes(b, longer, sizes[k + 1]);
+            same = same && memcmp(shorter, longer, sizes[k]) == 0;
+            rng_free(a);
+            rng_free(b);
+        }
+    printf("  Short fills are prefixes of longer ones: %s\n", same ? "yes" : "no");
+
+    // + engines only hand out their top 56 bits: three uint16, then a new word
+    a = rng_init(RNG_XOSHIRO256P, seed, 0);
+    b = rng_init(RNG_XOSHIRO256P, seed, 0);
+    w0 = rng_next_uint64(b);
+    w1 = rng_next_uint64(b);
+    same = 1;
+    for (int k = 0; k < 3; k++) same = same && rng_next_uint16(a) == (uint16_t)(w0 >> (48 - 16 * k));
+    same = same && rng_next_uint16(a) == (uint16_t)(w1 >> 48);
+    printf("  Xoshiro256+ skips weak low bits: %s\n", same ? "yes" : "no");
+    rng_free(a);
+    rng_free(b);
+
+    a = rng_init(RNG_PCG32, seed, 0);
+    int counts[6] = { 0 }, ones = 0;
+    for (int i = 0; i < 600000; i++) counts[rng_next_bounded(a, 6)]++;
+    for (int i = 0; i < 600000; i++) ones += rng_next_bool(a);
+    double chi = 0;
+    for (int k = 0; k < 6; k++) chi += (counts[k] - 100000.0) * (counts[k] - 100000.0) / 100000.0;
+    double mean = 0;
+    for (int i = 0; i < 100000; i++) mean += rng_next_bounded(a, 1000000);
+    printf("  Bounded(6) chi2 %.2f (5 dof), bounded(1e6) mean %.0f (exp 499999.5), bool mean %.4f\n",
+           chi, mean / 100000, ones / 600000.0);
+    rng_free(a);
+}
+
+static int get_bit(const uint8_t* p, size_t i) {
+    return p[i >> 3] >> (i & 7) & 1;
+}
+
+void test_lfsr(uint64_t seed) {
+    enum { NB = 1 << 20 };
+    static uint8_t pat[NB / 8];
+    static const struct { uint64_t poly; int degree; const char* name; } prbs[] = {
+        { RNG_PRBS7, 7, "PRBS7" }, { RNG_PRBS9, 9, "PRBS9" }, { RNG_PRBS15, 15, "PRBS15" },
+        { RNG_PRBS23, 23, "PRBS23" }, { RNG_PRBS31, 31, "PRBS31" },
+        { (1ULL << 63) | (1ULL << 62) | (1ULL << 60) | (1ULL << 59), 64, "x^64+x^63+x^61+x^60+1" },
+    };
+    for (int p = 0; p < 6; p++) {
+        rng_params_t lp = { .lfsr = { prbs[p].poly } };
+        rng_state_t* x = rng_init(RNG_LFSR, seed, &lp);
+        rng_fill_bytes(x, pat, 4096 / 8);
+        // bit-serial reference straight from the recurrence
+        bool same = 1;
+        for (int n = prbs[p].degree; n < 4096; n++) {
+            int b = 0;
+            for (int t = 1; t <= prbs[p].degree; t++)
+                if (prbs[p].poly >> (t - 1) & 1) b ^= get_bit(pat, n - t);
+            same = same && b == get_bit(pat, n);
+        }
+        // jump by 1000 bits lands on bit 1000, and by the full period on the start
+        rng_state_t* y = rng_init(RNG_LFSR, seed, &lp);
+        rng_lfsr_jump(y, 1000);
+        uint64_t w = rng_next_uint64(y), want = 0;
+        for (int k = 0; k < 64; k++) want |= (uint64_t)get_bit(pat, 1000 + k) << k;
+        rng_reseed(y, seed);
+        rng_lfsr_jump(y, prbs[p].degree == 64 ? ~0ULL : (1ULL << prbs[p].degree) - 1);
+        uint64_t first;
+        memcpy(&first, pat, 8);
+        bool period = prbs[p].degree == 64 || rng_next_uint64(y) == first;
+        printf("  %-22s recurrence %s, jump %s, period %s\n", prbs[p].name, same ? "yes" : "no",
+               w == want ? "yes" : "no", period ? "yes" : "no");
+        rng_free(x);
+        rng_free(y);
+    }
+
+    // m-sequence balance: one period of prbs7 from all ones has 64 ones
+    rng_params_t lp = { .lfsr = { RNG_PRBS7 } };
+    rng_state_t* x = rng_init(RNG_LFSR, ~0ULL, &lp);
+    rng_fill_bytes(x, pat, 16);
+    int ones = 0;
+    for (int i = 0; i < 127; i++) ones += get_bit(pat, i);
+    printf("  PRBS7 ones per period: %d (exp 64), first byte 0x%02x (exp 0x40)\n", ones, pat[0]);
+    rng_free(x);
+
+    // fills off a word boundary and narrow draws keep the sequence order
+    uint8_t odd[13], bytes8[13];
+    x = rng_init(RNG_LFSR, 0, &lp);
+    rng_fill_bytes(x, odd, sizeof(odd));
+    rng_reseed(x, 0);
+    bool bits = 1;
+    for (int i = 0; i < 104; i++) bits = bits && rng_next_bool(x) == get_bit(pat, i);
+    rng_reseed(x, 0);
+    for (int i = 0; i < 13; i++) bytes8[i] = rng_next_uint8(x);
+    printf("  PRBS7 13-byte fill: checker errors %llu (exp 0), prefix of 16 bytes %s, bools %s, uint8 %s\n",
+           (unsigned long long)rng_prbs_check(RNG_PRBS7, odd, 8 * sizeof(odd)),
+           !memcmp(odd, pat, sizeof(odd)) ? "yes" : "no", bits ? "in order" : "wrong",
+           !memcmp(bytes8, pat, sizeof(bytes8)) ? "in order" : "wrong");
+    rng_free(x);
+
+    // seed 0 is the all-ones window for rng_init and rng_reseed alike
+    lp.lfsr.poly = RNG_PRBS31;
+    rng_state_t* ones31 = rng_init(RNG_LFSR, (1ULL << 31) - 1, &lp);
+    rng_state_t* zero31 = rng_init(RNG_LFSR, 0, &lp);
+    uint64_t want0 = rng_next_uint64(ones31), got0 = rng_next_uint64(zero31);
+    rng_reseed(zero31, 0);
+    bool reseed0 = rng_next_uint64(zero31) == want0;
+    printf("  Seed 0 is the all-ones start: %s, after reseed: %s\n", got0 == want0 ? "yes" : "no",
+           reseed0 ? "yes" : "no");
+    rng_free(ones31);
+    rng_free(zero31);
+
+    lp.lfsr.poly = RNG_PRBS31;
+    x = rng_init(RNG_LFSR, seed, &lp);
+    rng_fill_bytes(x, pat, sizeof(pat));
+    uint64_t clean = rng_prbs_check(RNG_PRBS31, pat, NB);
+    for (int e = 0; e < 10; e++) pat[(e * 99991 + 4000) % (NB / 8)] ^= 1 << (e & 7);
+    uint64_t dirty = rng_prbs_check(RNG_PRBS31, pat, NB);
+    printf("  Checker errors clean %llu (exp 0), 10 flips %llu (exp 30)\n",
+           (unsigned long long)clean, (unsigned long long)dirty);
+    rng_free(x);
+}
+
+static uint64_t popcount_bytes(const uint8_t* p, size_t n) {
+    uint64_t c = 0;
+    for (size_t i = 0; i < n; i++) c += (uint64_t)__builtin_popcount(p[i]);
+    return c;
+}
+
+void test_fault(uint64_t seed) {
+    enum { BYTES = 1 << 20 };
+    static uint8_t buf[BYTES], buf2[BYTES];
+    rng_state_t* rng = rng_init(RNG_XOSHIRO256PP, seed, 0);
+
+    memset(buf, 0, sizeof(buf));
+    uint64_t ev = rng_fault_inject(rng, buf, 8ULL * BYTES, 1e-3, 1);
+    printf("  Rate 1e-3 over 8 Mbit: %llu flips (exp 8389 +- 92), popcount matches: %s\n",
+           (unsigned long long)ev, popcount_bytes(buf, BYTES) == ev ? "yes" : "no");
+
+    memset(buf, 0, sizeof(buf));
+    ev = rng_fault_inject(rng, buf, 8ULL * BYTES, 1e-4, 6);
+    printf("  Bursts of 6 at 1e-4: %llu events (exp ~839), %.2f bits/event (exp 4)\n",
+           (unsigned long long)ev, (double)popcount_bytes(buf, BYTES) / ev);
+
+    // fixed popcount, both below and above half density
+    static uint8_t mask[125];
+    uint64_t pos = 0;
+    bool exact = 1;
+    for (int r = 0; r < 2000; r++) {
+        rng_fault_mask(rng, mask, 1000, 37);
+        exact = exact && popcount_bytes(mask, 125) == 37;
+        for (int i = 0; i < 1000; i++) if (mask[i >> 3] >> (i & 7) & 1) pos += i;
+    }
+    rng_fault_mask(rng, mask, 1000, 990);
+    exact = exact && popcount_bytes(mask, 125) == 990;
+    printf("  Fixed-popcount masks exact: %s, mean bit index %.1f (exp 499.5)\n",
+           exact ? "yes" : "no", (double)pos / (2000 * 37));
+    rng_free(rng);
+
+    memset(buf, 0, sizeof(buf));
+    memset(buf2, 0, sizeof(buf2));
+    uint64_t e1 = rng_fault_inject_parallel(RNG_XOSHIRO256PP, seed, buf, 8ULL * BYTES, 1e-3, 1, 1);
+    uint64_t e4 = rng_fault_inject_parallel(RNG_XOSHIRO256PP, seed, buf2, 8ULL * BYTES, 1e-3, 1, 4);
+    printf("  Parallel 1 vs 4 threads identical: %s (%llu flips)\n",
+           e1 == e4 && memcmp(buf, buf2, sizeof(buf)) == 0 ? "yes" : "no", (unsigned long long)e1);
+}
+
+void test_weighted(uint64_t seed) {
+    enum { K = 10, DRAWS = 1000000 };
+    double w[K];
+    for (int i = 0; i < K; i++) w[i] = i + 1;
+    rng_weighted_t* t = rng_weighted_create(K, w);
+    rng_state_t* rng = rng_init(RNG_XOSHIRO256PP, seed, 0);
+
+    // w = 1..10, then zero out 3 and triple 9 mid-stream
+    double chi = 0;
+    long counts[K] = { 0 };
+    for (int i = 0; i < DRAWS; i++) counts[rng_weighted_sample(t, rng)]++;
+    for (int i = 0; i < K; i++) {
+        double e = DRAWS * w[i] / 55.0;
+        chi += (counts[i] - e) * (counts[i] - e) / e;
+    }
+    rng_weighted_update(t, 3, 0.0);
+    rng_weighted_update(t, 9, 30.0);
+    w[3] = 0.0; w[9] = 30.0;
+    double chi2 = 0, total = rng_weighted_total(t);
+    long counts2[K] = { 0 };
+    for (int i = 0; i < DRAWS; i++) counts2[rng_weighted_sample(t, rng)]++;
+    for (int i = 0; i < K; i++) {
+        if (!w[i]) continue;
+        double e = DRAWS * w[i] / total;
+        chi2 += (counts2[i] - e) * (counts2[i] - e) / e;
+    }
+    printf("  Chi2 before %.2f (9 dof), after update %.2f (8 dof), zeroed drawn %ld times, total %.1f (exp 71)\n",
+           chi, chi2, counts2[3], total);
+
+    // many small updates stay consistent with the exact sum
+    for (int i = 0; i < 100000; i++) {
+        size_t k = rng_next_bounded(rng, K);
+        w[k] = rng_next_double(rng) * 1e-3 + (k == 0 ? 1e6 : 0.0);
+        rng_weighted_update(t, k, w[k]);
+    }
+    double exact = 0;
+    for (int i = 0; i < K; i++) exact += w[i];
+    printf("  Total after 1e5 updates rel err %.2e\n", fabs(rng_weighted_total(t) - exact) / exact);
+    for (int i = 0; i < K; i++) rng_weighted_update(t, i, 0.0);
+    printf("  All-zero sample: %s\n", rng_weighted_sample(t, rng) == SIZE_MAX ? "SIZE_MAX" : "wrong");
+
+    // an infinite weight or an overflowing total would leave sample spinning
+    double big[2] = { 1e308, 1e308 }, inf1[2] = { 1.0, INFINITY };
+    bool refused = !rng_weighted_create(2, big) && !rng_weighted_create(2, inf1) &&
+                   !rng_weighted_update(t, 0, INFINITY) && rng_weighted_update(t, 0, 1e308) &&
+                   !rng_weighted_update(t, 1, 1e308) && rng_weighted_sample(t, rng) == 0;
+    printf("  Infinite weights and totals refused: %s\n", refused ? "yes" : "no");
+    rng_weighted_free(t);
+    rng_free(rng);
+}
+
+// moments of the standard normal truncated to [a, b], written with erfc
+// so they stay accurate in the far tails
+static void trunc_moments(double a, double b, double* mean, double* var) {
+    if (a > 0) {
+        trunc_moments(-b, -a, mean, var);
+        *mean = -*mean;
+        return;
+    }
+    double pa = exp(-0.5 * a * a) / sqrt(2 * M_PI), pb = exp(-0.5 * b * b) / sqrt(2 * M_PI);
+    double z = 0.5 * (erfc(-b / sqrt(2)) - erfc(-a / sqrt(2)));
+    double apa = isinf(a) ? 0 : a * pa, bpb = isinf(b) ? 0 : b * pb;
+    *mean = (pa - pb) / z;
+    *var = 1 + (apa - bpb) / z - *mean * *mean;
+}
+
+void test_trunc_normal(uint64_t seed) {
+    enum { N = 1000000 };
+    static const struct { double mean, sd, lo, hi; } cases[] = {
+        { 0, 1, -1, 1 }, { 0, 1, -2, INFINITY }, { 0, 1, 0.5, 1.5 }, { 0, 1, 1, INFINITY },
+        { 0, 1, 6, INFINITY }, { 0, 1, 20, INFINITY }, { 0, 1, 8, 8.5 }, { 0, 1, 8, 8.05 },
+        { 0, 1, -INFINITY, -6 }, { 10, 2, 12, 14 },
+    };
+    double* out = malloc(N * sizeof(double));
+    for (int c = 0; c < (int)(sizeof(cases) / sizeof(cases[0])); c++) {
+        rng_params_t p = { .trunc_normal = { cases[c].mean, cases[c].sd, cases[c].lo, cases[c].hi } };
+        rng_state_t* rng = rng_init(RNG_TRUNC_NORMAL, seed, &p);
+        double m = 0, sq = 0, em, ev;
+        long outside = 0;
+        rng_fill_distribution(rng, out, N);
+        for (int i = 0; i < N; i++) {
+            outside += out[i] < cases[c].lo || out[i] > cases[c].hi;
+            m += out[i];
+        }
+        m /= N;
+        for (int i = 0; i < N; i++) sq += (out[i] - m) * (out[i] - m);
+        trunc_moments((cases[c].lo - cases[c].mean) / cases[c].sd,
+                      (cases[c].hi - cases[c].mean) / cases[c].sd, &em, &ev);
+        printf("  [%g, %g]: mean %.5f (exp %.5f), var %.6f (exp %.6f), outside %ld\n",
+               cases[c].lo, cases[c].hi, m, cases[c].mean + cases[c].sd * em,
+               sq / N, cases[c].sd * cases[c].sd * ev, outside);
+        rng_free(rng);
+    }
+    free(out);
+
+    // the batch path matches single draws
+    rng_params_t p = { .trunc_normal = { 0, 1, 1, INFINITY } };
+    rng_state_t* r1 = rng_init(RNG_TRUNC_NORMAL, seed, &p);
+    rng_state_t* r2 = rng_init(RNG_TRUNC_NORMAL, seed, &p);
+    double batch[1000];
+    int same = 1;
+    rng_fill_distribution(r1, batch, 1000);
+    for (int i = 0; i < 1000; i++) same &= batch[i] == rng_next_distribution(r2);
+    printf("  Fill matches single draws: %s\n", same ? "yes" : "no");
+    print_stats(r1);
+    rng_free(r1);
+    rng_free(r2);
+
+    rng_params_t bad = { .trunc_normal = { 0, 1, 2, 1 } };
+    rng_params_t point = { .trunc_normal = { 0, 1, 3, 3 } };
+    rng_state_t* r3 = rng_init(RNG_TRUNC_NORMAL, seed, &point);
+    // a nan or infinite mean or stddev has no distribution to sample
+    rng_params_t nonfinite[] = { { .trunc_normal = { NAN, 1, 0, 1 } },
+                                 { .trunc_normal = { INFINITY, 1, 0, 1 } },
+                                 { .trunc_normal = { 0, INFINITY, 0, 1 } } };
+    bool refused = 1;
+    for (int i = 0; i < 3; i++) {
+        rng_state_t* r = rng_init(RNG_TRUNC_NORMAL, seed, &nonfinite[i]);
+        refused = refused && !r;
+        rng_free(r);
+    }
+    printf("  Empty interval rejected: %s, non-finite mean / stddev rejected: %s, point interval gives %g\n",
+           rng_init(RNG_TRUNC_NORMAL, seed, &bad) ? "no" : "yes", refused ? "yes" : "no",
+           rng_next_distribution(r3));
+    rng_free(r3);
+}
+
+// score = sum of the coordinates, a linear limit state
+static void sum_score(const double* x, size_t n, size_t dim, double* score, void* ctx) {
+    (void)ctx;
+    for (size_t i = 0; i < n; i++) {
+        double s = 0;
+        for (size_t j = 0; j < dim; j++) s += x[i * dim + j];
+        score[i] = s;
+    }
+}
+
+void test_is(uint64_t seed) {
+    // likelihood ratios average to 1 under any proposal
+    rng_is_t* is = rng_is_create(2, seed);
+    double shift[2] = { 1.5, -0.5 }, scale[2] = { 1.2, 0.8 }, x[2 * 10000], logw[10000], mw = 0;
+    rng_is_set_proposal(is, shift, scale);
+    rng_is_sample(is, x, logw, 10000);
+    for (int i = 0; i < 10000; i++) mw += exp(logw[i]);
+    printf("  Mean weight under shifted proposal: %.3f (exp 1)\n", mw / 10000);
+
+    // P(x0 + x1 >= 8) = Q(8 / sqrt(2)), tuned from N(0, I)
+    rng_is_set_proposal(is, NULL, NULL);
+    rng_is_result_t r;
+    int rounds = rng_is_tune(is, sum_score, NULL, 8.0, 10000, 0.1, 30, 1);
+    rng_is_get_proposal(is, shift, scale);
+    rng_is_estimate(is, sum_score, NULL, 8.0, 1000000, &r);
+    printf("  2-D sum >= 8: %d ce rounds, shift (%.2f, %.2f), scale (%.2f, %.2f)\n",
+           rounds, shift[0], shift[1], scale[0], scale[1]);
+    printf("    p = %.4e (exp %.4e), rel err %.4f, %zu hits, ess %.0f\n",
+           r.estimate, 0.5 * erfc(4.0), r.rel_err, r.hits, r.ess);
+    rng_is_free(is);
+
+    // 6 sigma tail, mean shift only
+    is = rng_is_create(1, seed);
+    rounds = rng_is_tune(is, sum_score, NULL, 6.0, 10000, 0.1, 30, 0);
+    rng_is_get_proposal(is, shift, NULL);
+    rng_is_estimate(is, sum_score, NULL, 6.0, 1000000, &r);
+    printf("  1-D x >= 6: %d ce rounds, shift %.2f, p = %.4e (exp %.4e), rel err %.4f\n",
+           rounds, shift[0], r.estimate, 0.5 * erfc(6.0 / sqrt(2)), r.rel_err);
+    rng_is_free(is);
+}
+
+// 2-d gaussian, mean (1, -2), stddevs (1, 2), correlation 0.8
+static void corr_logp(const double* x, size_t k, size_t dim, double* logp, double* grad, void* ctx) {
+    (void)dim; (void)ctx;
+    const double p00 = 4.0 / 1.44, p01 = -1.6 / 1.44, p11 = 1.0 / 1.44;
+    for (size_t c = 0; c < k; c++) {
+        double a = x[c] - 1.0, b = x[k + c] + 2.0;
+        double ga = p00 * a + p01 * b, gb = p01 * a + p11 * b;
+        logp[c] = -0.5 * (a * ga + b * gb);
+        if (grad) {
+            grad[c] = -ga;
+            grad[k + c] = -gb;
+        }
+    }
+}
+
+// standard normal in dim dimensions, for the benchmark
+static void std_logp(const double* x, size_t k, size_t dim, double* logp, double* grad, void* ctx) {
+    (void)ctx;
+    for (size_t c = 0; c < k; c++) logp[c] = 0;
+    for (size_t j = 0; j < dim; j++)
+        for (size_t c = 0; c < k; c++) {
+            logp[c] -= 0.5 * x[j * k + c] * x[j * k + c];
+            if (grad) grad[j * k + c] = -x[j * k + c];
+        }
+}
+
+// 1-d gaussian with stddev *ctx
+static void wide_logp(const double* x, size_t k, size_t dim, double* logp, double* grad, void* ctx) {
+    (void)dim; (void)grad;
+    double sd = *(const double*)ctx;
+    for (size_t c = 0; c < k; c++) logp[c] = -0.5 * (x[c] / sd) * (x[c] / sd);
+}
+
+void test_mcmc(uint64_t seed) {
+    enum { K = 512, BURN = 300, STEPS = 2000, THIN = 10, SNAPS = STEPS / THIN };
+    static const char* names[] = { "MH", "Slice", "HMC" };
+    double* out = malloc((size_t)SNAPS * 2 * K * sizeof(double));
+    for (int kind = RNG_MCMC_MH; kind <= RNG_MCMC_HMC; kind++) {
+        rng_mcmc_t* m = rng_mcmc_create(kind, K, 2, corr_logp, NULL, seed);
+        rng_mcmc_run(m, BURN, 0, NULL, 0);
+        rng_mcmc_run(m, STEPS, THIN, out, 0);
+        double m0 = 0, m1 = 0, v0 = 0, v1 = 0, cov = 0, n = (double)SNAPS * K;
+        for (size_t s = 0; s < SNAPS; s++)
+            for (size_t c = 0; c < K; c++) {
+                m0 += out[s * 2 * K + c];
+                m1 += out[s * 2 * K + K + c];
+            }
+        m0 /= n; m1 /= n;
+        for (size_t s = 0; s < SNAPS; s++)
+            for (size_t c = 0; c < K; c++) {
+                double a = out[s * 2 * K + c] - m0, b = out[s * 2 * K + K + c] - m1;
+                v0 += a * a; v1 += b * b; cov += a * b;
+            }
+        v0 /= n; v1 /= n; cov /= n;
+        printf("  %s: mean (%.3f, %.3f) exp (1, -2), var (%.3f, %.3f) exp (1, 4), corr %.3f exp 0.8\n",
+               names[kind], m0, m1, v0, v1, cov / sqrt(v0 * v1));
+        printf("    acceptance %.3f, %.2f evals per step\n", rng_mcmc_acceptance(m), rng_mcmc_evals_per_step(m));
+        rng_mcmc_free(m);
+    }
+    free(out);
+
+    // thread count does not change the chains
+    double a[2 * 700], b[2 * 700];
+    rng_mcmc_t* m1 = rng_mcmc_create(RNG_MCMC_SLICE, 700, 2, corr_logp, NULL, seed);
+    rng_mcmc_t* m4 = rng_mcmc_create(RNG_MCMC_SLICE, 700, 2, corr_logp, NULL, seed);
+    rng_mcmc_run(m1, 50, 0, NULL, 1);
+    rng_mcmc_run(m4, 50, 0, NULL, 4);
+    rng_mcmc_get_position(m1, a);
+    rng_mcmc_get_position(m4, b);
+    printf("  1 vs 4 threads identical: %s\n", memcmp(a, b, sizeof(a)) ? "no" : "yes");
+    rng_mcmc_free(m1);
+    rng_mcmc_free(m4);
+
+    // targets much wider than the default bracket of 2 hit the stepping-out
+    // cap; started in the stationary distribution, the chains must stay there
+    enum { W = 4096 };
+    static const double sds[] = { 1, 20, 60 };
+    double* x = malloc(W * sizeof(double));
+    rng_params_t gp = { .gaussian = { 0.0, 1.0 } };
+    rng_state_t* g = rng_init(RNG_GAUSSIAN, seed, &gp);
+    printf("  Slice on wide targets, var / sd^2 (exp 1 +- %.3f):", sqrt(2.0 / W));
+    for (int k = 0; k < 3; k++) {
+        double sd = sds[k], v = 0;
+        for (int c = 0; c < W; c++) x[c] = sd * rng_next_distribution(g);
+        rng_mcmc_t* m = rng_mcmc_create(RNG_MCMC_SLICE, W, 1, wide_logp, (void*)&sd, seed);
+        rng_mcmc_set_position(m, x);
+        rng_mcmc_run(m, 200, 0, NULL, 0);
+        rng_mcmc_get_position(m, x);
+        for (int c = 0; c < W; c++) v += x[c] * x[c];
+        printf(" sd %g %.3f", sd, v / W / (sd * sd));
+        rng_mcmc_free(m);
+    }
+    printf("\n");
+    rng_free(g);
+    free(x);
+}
+
+void test_resample(uint64_t seed) {
+    enum { N = 300000, M = 200000 };
+    static const char* names[] = { "Systematic", "Stratified", "Residual" };
+    double* w = malloc(N * sizeof(double));
+    size_t* out = malloc(M * sizeof(size_t));
+    size_t* out4 = malloc(M * sizeof(size_t));
+    long* cnt = malloc(N * sizeof(long));
+    rng_state_t* rng = rng_init(RNG_XOSHIRO256PP, seed, 0);
+    double total = 0;
+    for (int i = 0; i < N; i++) {
+        w[i] = i % 7 == 3 ? 0.0 : rng_next_double(rng) * (1 + i % 5);
+        total += w[i];
+    }
+    for (int kind = RNG_RESAMPLE_SYSTEMATIC; kind <= RNG_RESAMPLE_RESIDUAL; kind++) {
+        rng_reseed(rng, seed);
+        rng_resample(rng, kind, w, N, out, M, 1);
+        rng_reseed(rng, seed);
+        rng_resample(rng, kind, w, N, out4, M, 4);
+        int sorted = 1;
+        long zero = 0;
+        double maxdev = 0, chi = 0;
+        for (int i = 0; i < N; i++) cnt[i] = 0;
+        for (int j = 0; j < M; j++) {
+            cnt[out[j]]++;
+            if (j && out[j] < out[j - 1]) sorted = 0;
+        }
+        for (int i = 0; i < N; i++) {
+            double e = M * w[i] / total;
+            if (!w[i]) zero += cnt[i];
+            else chi += (cnt[i] - e) * (cnt[i] - e) / e;
+            if (fabs(cnt[i] - e) > maxdev) maxdev = fabs(cnt[i] - e);
+        }
+        printf("  %s: sorted %s, zero-weight picks %ld, max |count - m w| %.3f, chi2/dof %.3f, threads agree %s\n",
+               names[kind], sorted ? "yes" : "no", zero, maxdev, chi / (N - N / 7),
+               memcmp(out, out4, M * sizeof(size_t)) ? "no" : "yes");
+    }
+    double one = 2.5, none[3] = { 0, -1, 0 };
+    size_t o[4];
+    bool ok = rng_resample(rng, RNG_RESAMPLE_SYSTEMATIC, &one, 1, o, 4, 0);
+    printf("  Single particle: %s, all-zero weights rejected: %s\n",
+           ok && o[0] == 0 && o[3] == 0 ? "ok" : "wrong",
+           rng_resample(rng, RNG_RESAMPLE_RESIDUAL, none, 3, o, 4, 0) ? "no" : "yes");
+    rng_free(rng);
+    free(w);
+    free(out);
+    free(out4);
+    free(cnt);
+}
+
+void test_field(uint64_t seed) {
+    enum { NX = 48, NY = 40, PAIRS = 400 };
+    static const int lags[][2] = { { 0, 0 }, { 1, 0 }, { 0, 3 }, { 4, 5 }, { 10, 0 } };
+    enum { LAGS = sizeof(lags) / sizeof(lags[0]) };
+    rng_cov_params_t cp = { 2.0, 5.0 };
+    static const struct { rng_cov_fn fn; const char* name; } kernels[] = {
+        { rng_cov_exponential, "Exponential" },
+        { rng_cov_matern32, "Matern 3/2" },
+        { rng_cov_gaussian, "Gaussian" },
+    };
+    double* a = malloc(NX * NY * sizeof(double));
+    double* b = malloc(NX * NY * sizeof(double));
+    for (int k = 0; k < 3; k++) {
+        rng_field_t* f = rng_field_create(NX, NY, 0.5, kernels[k].fn, &cp, seed, 0);
+        double acc[LAGS] = { 0 }, mean = 0;
+        long cnt[LAGS] = { 0 };
+        for (int r = 0; r < PAIRS; r++) {
+            rng_field_generate(f, a, b);
+            for (int h = 0; h < 2; h++) {
+                const double* v = h ? b : a;
+                for (int x = 0; x < NX; x++)
+                    for (int y = 0; y < NY; y++) {
+                        mean += v[x * NY + y];
+                        for (int l = 0; l < LAGS; l++) {
+                            int x2 = x + lags[l][0], y2 = y + lags[l][1];
+                            if (x2 >= NX || y2 >= NY) continue;
+                            acc[l] += v[x * NY + y] * v[x2 * NY + y2];
+                            cnt[l]++;
+                        }
+                    }
+            }
+        }
+        printf("  %s: mean %.4f, clipped %.2e\n   ", kernels[k].name, mean / (2.0 * PAIRS * NX * NY),
+               rng_field_negative_mass(f));
+        for (int l = 0; l < LAGS; l++)
+            printf(" c(%d,%d) %.3f/%.3f", lags[l][0], lags[l][1], acc[l] / cnt[l],
+                   kernels[k].fn(0.5 * lags[l][0], 0.5 * lags[l][1], &cp));
+        printf("\n");
+        rng_field_free(f);
+    }
+
+    // same fields on 1 and 4 threads, and b = NULL hands out the pair in order
+    rng_field_t* f1 = rng_field_create(NX, NY, 0.5, rng_cov_exponential, &cp, seed, 1);
+    rng_field_t* f4 = rng_field_create(NX, NY, 0.5, rng_cov_exponential, &cp, seed, 4);
+    double* c = malloc(NX * NY * sizeof(double));
+    double* d = malloc(NX * NY * sizeof(double));
+    rng_field_generate(f1, a, b);
+    rng_field_generate(f4, c, NULL);
+    rng_field_generate(f4, d, NULL);
+    printf("  1 vs 4 threads identical: %s\n",
+           memcmp(a, c, NX * NY * sizeof(double)) || memcmp(b, d, NX * NY * sizeof(double)) ? "no" : "yes");
+    rng_field_free(f1);
+    rng_field_free(f4);
+    free(a); free(b); free(c); free(d);
+}
+
+// ar(2) noise recovered from calls of 4097 steps that continue one
+// another: each call splits into 4096-step blocks, so its first step
+// (carried over from the last call) and its last step both follow a seam.
+// returns the noise variance at seams and elsewhere.
+static void arma_seams(size_t series, int calls, uint64_t seed, double* seam, long* ns, double* other) {
+    enum { L = 4097 };
+    double phi[2] = { 0.5, -0.3 }, so = 0;
+    long no = 0;
+    rng_arma_t* a = rng_arma_create(2, phi, 0, NULL, 1.0, series, seed);
+    double* x = malloc((L + 2) * series * sizeof(double));  // two rows of the last call in front
+    *seam = 0;
+    *ns = 0;
+    for (int c = 0; c < calls; c++) {
+        rng_arma_generate(a, x + 2 * series, L, 0);
+        for (size_t t = c ? 0 : 2; t < L; t++)
+            for (size_t s = 0; s < series; s++) {
+                size_t i = (t + 2) * series + s;
+                double e = x[i] - 0.5 * x[i - series] + 0.3 * x[i - 2 * series];
+                if (t == 0 || t == 4096) { *seam += e * e; ++*ns; }
+                else { so += e * e; no++; }
+            }
+        memcpy(x, x + L * series, 2 * series * sizeof(double));
+    }
+    *seam /= (double)*ns;
+    *other = so / (double)no;
+    rng_arma_free(a);
+    free(x);
+}
+
+void test_arma(uint64_t seed) {
+    enum { S = 256, LEN = 10000, S0 = 1 << 18 };
+    static const struct { size_t p, q; double phi[2], theta[1]; const char* name; } models[] = {
+        { 1, 0, { 0.9 }, { 0 }, "AR(1) 0.9" },
+        { 2, 0, { 0.5, -0.3 }, { 0 }, "AR(2) 0.5 -0.3" },
+        { 1, 1, { 0.7 }, { 0.4 }, "ARMA(1,1) 0.7 0.4" },
+    };
+    double* out = malloc((size_t)S * LEN * sizeof(double));
+    for (int k = 0; k < 3; k++) {
+        double f1 = models[k].phi[0], f2 = models[k].phi[1], th = models[k].theta[0];
+        // theoretical variance and lag-1/2 autocorrelations
+        double g0, r1, r2;
+        if (models[k].q) {
+            g0 = (1 + 2 * f1 * th + th * th) / (1 - f1 * f1);
+            r1 = (1 + f1 * th) * (f1 + th) / (1 + 2 * f1 * th + th * th);
+            r2 = f1 * r1;
+        } else {
+            r1 = f1 / (1 - f2);
+            r2 = f1 * r1 + f2;
+            g0 = 1 / (1 - f1 * r1 - f2 * r2);
+        }
+        rng_arma_t* a = rng_arma_create(models[k].p, models[k].phi, models[k].q, models[k].theta, 1.0, S, seed);
+        // the first sample over many more series, to see the stationary start
+        rng_arma_t* a0 = rng_arma_create(models[k].p, models[k].phi, models[k].q, models[k].theta, 1.0, S0, seed);
+        rng_arma_generate(a0, out, 1, 0);
+        double v0 = 0, v = 0, c1 = 0, c2 = 0;
+        for (int s = 0; s < S0; s++) v0 += out[s] * out[s];
+        rng_arma_free(a0);
+        rng_arma_generate(a, out, LEN, 0);
+        for (int t = 0; t < LEN; t++)
+            for (int s = 0; s < S; s++) {
+                double x = out[(size_t)t * S + s];
+                v += x * x;
+                if (t >= 1) c1 += x * out[(size_t)(t - 1) * S + s];
+                if (t >= 2) c2 += x * out[(size_t)(t - 2) * S + s];
+            }
+        v /= (double)LEN * S;
+        printf("  %s: var %.3f (exp %.3f, model %.3f), var at t=1 %.3f (+- %.3f), rho1 %.3f (exp %.3f), "
+               "rho2 %.3f (exp %.3f)\n",
+               models[k].name, v, g0, rng_arma_variance(a), v0 / S0, g0 * sqrt(2.0 / S0),
+               c1 / ((double)(LEN - 1) * S) / v, r1,
+               c2 / ((double)(LEN - 2) * S) / v, r2);
+        rng_arma_free(a);
+    }
+
+    // block stitching: the noise recovered from the output has unit variance
+    // at the 4096-step block seams as elsewhere (see arma_seams), the thread
+    // count does not matter, and a unit root is refused
+    double phi[2] = { 0.5, -0.3 }, unit = 1.0;
+    rng_arma_t* a1 = rng_arma_create(2, phi, 0, NULL, 1.0, S, seed);
+    rng_arma_t* a4 = rng_arma_create(2, phi, 0, NULL, 1.0, S, seed);
+    double* o4 = malloc((size_t)S * LEN * sizeof(double));
+    rng_arma_generate(a1, out, LEN, 1);
+    rng_arma_generate(a4, o4, LEN, 4);
+    bool same = !memcmp(out, o4, (size_t)S * LEN * sizeof(double));
+    rng_arma_free(a1);
+    rng_arma_free(a4);
+    free(o4);
+    free(out);
+    double seam, other, seam1, other1;
+    long ns, ns1;
+    arma_seams(1024, 8, seed, &seam, &ns, &other);
+    arma_seams(1, 4000, seed, &seam1, &ns1, &other1);  // the scalar single-series path
+    // standard errors of a unit-variance estimate over n samples: sqrt(2 / n)
+    printf("  Noise var at seams %.3f (+- %.3f), elsewhere %.3f (exp 1); single series %.3f (+- %.3f), "
+           "elsewhere %.3f\n", seam, sqrt(2.0 / ns), other, seam1, sqrt(2.0 / ns1), other1);
+    double explosive = 2.0;
+    rng_arma_t* ae = rng_arma_create(1, &explosive, 0, NULL, 0.0, 1, seed);
+    printf("  1 vs 4 threads identical: %s, unit root rejected: %s, explosive root with sigma 0 rejected: %s\n",
+           same ? "yes" : "no", rng_arma_create(1, &unit, 0, NULL, 1.0, 1, seed) ? "no" : "yes",
+           ae ? "no" : "yes");
+    rng_arma_free(ae);
+
+    // sigma scales the innovations as well as the stationary start: AR(1)
+    // 0.5 with sigma 3 has var 9 / 0.75 = 12 at the first step and after
+    double half = 0.5, v1 = 0, vn = 0;
+    rng_arma_t* as = rng_arma_create(1, &half, 0, NULL, 3.0, S, seed);
+    double* xs = malloc((size_t)S * LEN * sizeof(double));
+    rng_arma_generate(as, xs, LEN, 0);
+    for (int s = 0; s < S; s++) v1 += xs[s] * xs[s];
+    for (size_t i = 0; i < (size_t)S * LEN; i++) vn += xs[i] * xs[i];
+    printf("  Sigma 3: var %.3f, var at t=1 %.3f (+- %.3f), model %.3f\n", vn / ((double)S * LEN),
+           v1 / S, 12.0 * sqrt(2.0 / S), rng_arma_variance(as));
+    rng_arma_free(as);
+    free(xs);
+}
+
+void test_sketch(uint64_t seed) {
+    // sizes off the 64 x 128 tiles and 128-row task blocks
+    enum { D = 300, K = 200, N = 150 };
+    static const char* names[] = { "Gaussian", "Rademacher", "Achlioptas" };
+    double* r = malloc((size_t)D * K * sizeof(double));
+    double* x = malloc((size_t)N * D * sizeof(double));
+    double* y = malloc((size_t)N * K * sizeof(double));
+    double* y4 = malloc((size_t)N * K * sizeof(double));
+    double* ref = malloc((size_t)N * K * sizeof(double));
+    rng_params_t gp = { .gaussian = {0.0, 1.0} };
+    rng_state_t* g = rng_init(RNG_GAUSSIAN, seed, &gp);
+    rng_fill_distribution(g, x, (size_t)N * D);
+    for (int kind = RNG_SKETCH_GAUSSIAN; kind <= RNG_SKETCH_ACHLIOPTAS; kind++) {
+        rng_sketch_t* s = rng_sketch_create(kind, D, K, 0.0, seed);
+        rng_sketch_rows(s, 0, D, r);
+        // against the materialized matrix: x R (n points) and R^T x' (x
+        // read as a d x n matrix)
+        double err = 0, errl = 0, mean = 0, var = 0, norm = 0;
+        long nz = 0;
+        rng_sketch_apply(s, x, N, y, 0);
+        rng_sketch_apply(s, x, N, y4, 4);
+        for (int i = 0; i < N; i++) {
+            double nx = 0, ny = 0;
+            for (int j = 0; j < K; j++) {
+                double acc = 0;
+                for (int t = 0; t < D; t++) acc += x[i * D + t] * r[t * K + j];
+                err = fmax(err, fabs(acc - y[i * K + j]));
+                ny += y[i * K + j] * y[i * K + j];
+            }
+            for (int t = 0; t < D; t++) nx += x[i * D + t] * x[i * D + t];
+            norm += ny / nx;
+        }
+        rng_sketch_apply_left(s, x, N, ref, 0);
+        for (int j = 0; j < K; j++)
+            for (int c = 0; c < N; c++) {
+                double acc = 0;
+                for (int t = 0; t < D; t++) acc += r[t * K + j] * x[t * N + c];
+                errl = fmax(errl, fabs(acc - ref[j * N + c]));
+            }
+        for (int i = 0; i < D * K; i++) {
+            mean += r[i];
+            var += r[i] * r[i];
+            nz += r[i] != 0.0;
+        }
+        // a few rows on their own are the same rows
+        double part[3 * K];
+        rng_sketch_rows(s, 17, 3, part);
+        printf("  %s: max err x R %.1e, R^T a %.1e, mean %.4f, k var %.3f (exp 1), nonzero %.3f (exp %.3f), "
+               "|xR|^2 / |x|^2 %.3f (exp 1), rows match: %s, 1 vs 4 threads identical: %s\n",
+               names[kind], err, errl, mean / (D * K), var / (D * K) * K, (double)nz / (D * K),
+               rng_sketch_density(s), norm / N, memcmp(part, r + 17 * K, sizeof(part)) ? "no" : "yes",
+               memcmp(y, y4, (size_t)N * K * sizeof(double)) ? "no" : "yes");
+        rng_sketch_free(s);
+    }
+    printf("  Bad density rejected: %s\n", rng_sketch_create(RNG_SKETCH_ACHLIOPTAS, D, K, 1.5, seed) ? "no" : "yes");
+    rng_free(g);
+    free(r); free(x); free(y); free(y4); free(ref);
+}
+
+// uneven work per task, so workers finish at different times and steal
+static void sum_task(rng_state_t* rng, size_t task_id, void* ctx) {
+    double* out = ctx, sum = 0;
+    size_t n = (1 + task_id % 13) * 1000;
+    for (size_t i = 0; i < n; i++) sum += rng_next_double(rng);
+    out[task_id] = sum / n;
+}
+
+void test_tasks(uint64_t seed) {
+    enum { TASKS = 300 };
+    static double ref[TASKS], got[TASKS];
+    int threads[] = { 3, 8, 32 };
+    rng_run_tasks(RNG_XOSHIRO256PP, seed, 0, TASKS, 1, sum_task, ref);
+    double mean = 0;
+    for (int i = 0; i < TASKS; i++) mean += ref[i] / TASKS;
+    printf("  Mean of task means: %f (exp 0.5)\n", mean);
+    for (int t = 0; t < 3; t++) {
+        rng_run_tasks(RNG_XOSHIRO256PP, seed, 0, TASKS, threads[t], sum_task, got);
+        printf("  %2d threads reproduce 1 thread: %s\n", threads[t],
+               memcmp(ref, got, sizeof(ref)) == 0 ? "yes" : "no");
+    }
+}
+
+#define SHARED_THREADS 4
+
+typedef struct { rng_shared_t* h; uint64_t first; double mean; } shared_arg_t;
+
+static void* shared_worker(void* p) {
+    shared_arg_t* a = p;
+    a->first = rng_shared_next_uint64(a->h);
+    double sum = 0;
+    for (int i = 0; i < SAMPLE_SIZE; i++) sum += rng_shared_next_double(a->h);
+    a->mean = sum / SAMPLE_SIZE;
+    return NULL;
+}
+
+void test_shared(uint64_t seed) {
+    // the given seed, then seed 0 (clock seed), whose threads all attach
+    // within the same second
+    for (int pass = 0; pass < 2; pass++) {
+        rng_shared_t* h = rng_shared_init(RNG_XOSHIRO256PP, pass ? 0 : seed, 0);
+        pthread_t th[SHARED_THREADS];
+        shared_arg_t args[SHARED_THREADS];
+        for (int i = 0; i < SHARED_THREADS; i++) {
+            args[i].h = h;
+            pthread_create(&th[i], NULL, shared_worker, &args[i]);
+        }
+        int distinct = 1;
+        for (int i = 0; i < SHARED_THREADS; i++) {
+            pthread_join(th[i], NULL);
+            if (!pass) printf("  Thread %d mean: %f (exp 0.5)\n", i, args[i].mean);
+            for (int j = 0; j < i; j++) if (args[i].first == args[j].first) distinct = 0;
+        }
+        printf("  Per-thread streams distinct%s: %s\n", pass ? " (seed 0)" : "", distinct ? "yes" : "no");
+        if (!pass)
+            printf("  Shard state on its own cache line: %s\n",
+                   (uintptr_t)rng_shared_local(h) % 64 == 0 ? "yes" : "no");
+        rng_shared_free(h);
+    }
+}
+
+// takes blocks after the producer has gone to sleep on the full ring; two
+// blocks' worth, since the client may still hold a partly used local one
+static void* service_claimer(void* p) {
+    static uint8_t buf[2 * 4096];
+    struct timespec delay = { 0, 50000000 };
+    nanosleep(&delay, NULL);
+    rng_fill_bytes(p, buf, sizeof(buf));
+    return NULL;
+}
+
+void test_service(uint64_t seed) {
+    enum { BLOCK = 4096, BLOCKS = 8 };
+    char name[64];
+    snprintf(name, sizeof(name), "/rng-test-%llu", (unsigned long long)seed);
+    rng_service_t* svc = rng_service_create(name, RNG_AES128CTR, seed, BLOCK, BLOCKS);
+    if (!svc) {
+        printf("  Service create failed (no /dev/shm?)\n");
+        return;
+    }
+    size_t made = rng_service_pump(svc);
+    rng_state_t* client = rng_service_connect(name, RNG_XOSHIRO256PP, seed);
+    rng_state_t* ref = rng_init(RNG_AES128CTR, seed, 0);
+    static uint8_t got[BLOCK * BLOCKS], want[BLOCK * BLOCKS];
+    rng_fill_bytes(client, got, sizeof(got));
+    rng_fill_bytes(ref, want, sizeof(want));
+    uint64_t served = 0, local = 0;
+    rng_next_uint64(client);  // ring is drained now, so this comes from the fallback
+    rng_service_counts(client, &served, &local);
+    printf("  Blocks produced: %zu\n", made);
+    printf("  Client matches producer stream: %s\n", memcmp(got, want, sizeof(got)) == 0 ? "yes" : "no");
+    printf("  Served %llu, local fallback %llu (exp %d, 1)\n",
+           (unsigned long long)served, (unsigned long long)local, BLOCKS);
+
+    // a second producer cannot take the name of a live one
+    rng_service_t* second = rng_service_create(name, RNG_AES128CTR, seed, BLOCK, BLOCKS);
+    printf("  Live ring kept from a second producer: %s\n", second ? "no" : "yes");
+    rng_service_free(second);
+
+    // a full ring: wait times out, then wakes once a client takes a block
+    rng_service_pump(svc);
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    bool full = !rng_service_wait(svc, 20);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    pthread_t th;
+    pthread_create(&th, NULL, service_claimer, client);
+    bool woke = rng_service_wait(svc, 5000);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    pthread_join(th, NULL);
+    printf("  Wait on a full ring: timed out %s after %.3f s, woken by a claim %s after %.3f s\n",
+           full ? "yes" : "no", (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9,
+           woke ? "yes" : "no", (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) * 1e-9);
+    rng_free(ref);
+    rng_free(client);
+    rng_service_free(svc);
+
+#ifdef __linux__
+    // hand-made rings with a valid magic but bad geometry: zero, unaligned
+    // and overflowing sizes all leave the client on its local engine
+    static const uint64_t bad[][2] = { { 0, 8 }, { 4096, 0 }, { 100, 8 }, { 1ULL << 62, 1ULL << 8 } };
+    bool fallback = 1;
+    for (int i = 0; i < 4; i++) {
+        int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+        uint64_t hdr[3] = { 0x726e67736863ULL, bad[i][0], bad[i][1] };
+        if (fd < 0 || ftruncate(fd, 65536) != 0 || pwrite(fd, hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+            fallback = 0;
+        } else {
+            rng_state_t* c = rng_service_connect(name, RNG_XOSHIRO256PP, seed);
+            uint8_t buf[100];
+            rng_fill_bytes(c, buf, sizeof(buf));
+            served = local = 0;
+            rng_service_counts(c, &served, &local);
+            fallback = fallback && c && served == 0 && local > 0;
+            rng_free(c);
+        }
+        if (fd >= 0) close(fd);
+        shm_unlink(name);
+    }
+    printf("  Malformed rings fall back to the local engine: %s\n", fallback ? "yes" : "no");
+
+    // a producer that exits without freeing leaves a stale ring behind,
+    // which the next create replaces
+    pid_t pid = fork();
+    if (pid == 0) _exit(rng_service_create(name, RNG_AES128CTR, seed, BLOCK, BLOCKS) ? 0 : 1);
+    int status = 1;
+    if (pid > 0) waitpid(pid, &status, 0);
+    svc = rng_service_create(name, RNG_AES128CTR, seed, BLOCK, BLOCKS);
+    printf("  Stale ring of a dead producer replaced: %s\n",
+           pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0 && svc ? "yes" : "no");
+    rng_service_free(svc);
+#endif
+}
+
+// outputs drawn through every kernel the tuner can switch, before and after
+static void autotune_sample(uint64_t seed, double* out, size_t n) {
+    rng_type_t types[] = { RNG_AES128CTR, RNG_ARS5, RNG_DSFMT, RNG_XOSHIRO256PP };
+    for (int e = 0; e < 4; e++) {
+        rng_state_t* rng = rng_init(types[e], seed, 0);
+        if (types[e] == RNG_DSFMT || types[e] == RNG_XOSHIRO256PP) rng_fill_double(rng, out + e * n, n);
+        else rng_fill_bytes(rng, out + e * n, n * sizeof(double));
+        rng_free(rng);
+    }
+}
+
+// resamples while the tuner switches kernels under it, counting results
+// that differ from the untuned ones
+enum { TUNE_N = 100003 };
+typedef struct { uint64_t seed; const double* want; bool stop; int rounds, wrong; } tune_race_t;
+
+static void* tune_racer(void* p) {
+    tune_race_t* r = p;
+    static double got[4 * TUNE_N];
+    while (!__atomic_load_n(&r->stop, __ATOMIC_RELAXED)) {
+        autotune_sample(r->seed, got, TUNE_N);
+        r->wrong += memcmp(got, r->want, sizeof(got)) != 0;
+        r->rounds++;
+    }
+    return NULL;
+}
+
+void test_autotune(uint64_t seed) {
+    enum { N = TUNE_N };
+    static double before[4 * N], after[4 * N];
+    char dir[] = "/tmp/rng-tune-XXXXXX", path[128];
+    if (!mkdtemp(dir)) {
+        printf("  mkdtemp failed\n");
+        return;
+    }
+    setenv("XDG_CACHE_HOME", dir, 1);
+    autotune_sample(seed, before, N);
+
+    // calibration may run while other threads generate
+    tune_race_t race = { seed, before, 0, 0, 0 };
+    pthread_t th;
+    pthread_create(&th, NULL, tune_racer, &race);
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    bool ok = rng_autotune();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    __atomic_store_n(&race.stop, 1, __ATOMIC_RELAXED);
+    pthread_join(th, NULL);
+    ok = rng_autotune() && ok;
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    printf("  Calibrated: %s in %.3f s, cached reload %.6f s\n", ok ? "yes" : "no",
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9,
+           (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) * 1e-9);
+
+    autotune_sample(seed, after, N);
+    printf("  Streams unchanged: %s, during calibration: %d of %d rounds differ (exp 0)\n",
+           memcmp(before, after, sizeof(before)) == 0 ? "yes" : "no", race.wrong, race.rounds);
+
+    snprintf(path, sizeof(path), "%s/rng-lib/autotune", dir);
+    FILE* f = fopen(path, "r");
+    printf("  Cache file written: %s\n", f ? "yes" : "no");
+    if (f) fclose(f);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/rng-lib", dir);
+    remove(path);
+    remove(dir);
+    unsetenv("XDG_CACHE_HOME");
+}
+
+// hardware counters for the benchmarks via perf_event_open. events the
+// kernel or vm does not expose are skipped; with none available the
+// benchmarks print timings only.
+enum { PERF_CYCLES, PERF_INSNS, PERF_BRANCH_MISSES, PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_EVENTS };
+
+typedef struct {
+    int fd[PERF_EVENTS];
+    uint64_t val[PERF_EVENTS];
+    struct timespec t0;
+} bench_t;
+
+#ifdef __linux__
+static int perf_open(uint32_t type, uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // threads created while counting (rng_run_tasks workers) add their
+    // counts to ours when they exit
+    attr.inherit = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+static void bench_init(bench_t* b) {
+    for (int i = 0; i < PERF_EVENTS; i++) b->fd[i] = -1;
+#ifdef __linux__
+    static const struct { uint32_t type; uint64_t config; } ev[PERF_EVENTS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    };
+    b->fd[0] = perf_open(ev[0].type, ev[0].config, -1);
+    if (b->fd[0] < 0) return;
+    for (int i = 1; i < PERF_EVENTS; i++) b->fd[i] = perf_open(ev[i].type, ev[i].config, b->fd[0]);
+#endif
+}
+
+static void bench_close(bench_t* b) {
+#ifdef __linux__
+    for (int i = 0; i < PERF_EVENTS; i++) if (b->fd[i] >= 0) close(b->fd[i]);
+#endif
+    (void)b;
+}
+
+static void bench_start(bench_t* b) {
+#ifdef __linux__
+    if (b->fd[0] >= 0) {
+        ioctl(b->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(b->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &b->t0);
+}
+
+// prints "name: time (rate)" plus per-number counter ratios when available
+static double bench_stop(bench_t* b, const char* name, double count) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+#ifdef __linux__
+    if (b->fd[0] >= 0) ioctl(b->fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (int i = 0; i < PERF_EVENTS; i++) {
+        b->val[i] = 0;
+        if (b->fd[i] >= 0 && read(b->fd[i], &b->val[i], sizeof(uint64_t)) != sizeof(uint64_t)) b->val[i] = 0;
+    }
+#endif
+    double t = (t1.tv_sec - b->t0.tv_sec) + (t1.tv_nsec - b->t0.tv_nsec) * 1e-9;
+    printf("  %s: %.2f s (%.2f Mnums/s)", name, t, count / (t * 1e6));
+    if (b->fd[0] >= 0 && b->val[PERF_CYCLES]) {
+        printf(" | %.2f cyc/num", b->val[PERF_CYCLES] / count);
+        if (b->fd[PERF_INSNS] >= 0) printf(", IPC %.2f", (double)b->val[PERF_INSNS] / b->val[PERF_CYCLES]);
+        if (b->fd[PERF_BRANCH_MISSES] >= 0) printf(", br-miss %.4f", b->val[PERF_BRANCH_MISSES] / count);
+        if (b->fd[PERF_L1D_MISSES] >= 0) printf(", L1D-miss %.4f", b->val[PERF_L1D_MISSES] / count);
+        if (b->fd[PERF_LLC_MISSES] >= 0) printf(", LLC-miss %.5f", b->val[PERF_LLC_MISSES] / count);
+    }
+    printf("\n");
+    return t;
+}
+
+static bool sum_block(void* block, size_t n, void* ctx) {
+    const double* v = block;
+    double s = 0;
+    for (size_t i = 0; i < n; i++) s += v[i];
+    *(double*)ctx += s;
+    return 1;
+}
+
 void test_speed() {
-    int n = 100000000;
-    clock_t start, end;
+    int n = 100000000, nd = 10000000;
     uint64_t dummy = 0;
+    double sink = 0;
+    static uint64_t buf[4096];
+    char name[64];
+    bench_t b;
+    bench_init(&b);
+    if (b.fd[0] < 0) printf("  (hardware counters unavailable, timings only)\n");
 
-    rng_state_t* xoshiro = rng_init(RNG_XOSHIRO256PP, 12345, 0);
-    start = clock();
-    for (int i = 0; i < n; i++) dummy ^= rng_next_uint64(xoshiro);
-    end = clock();
-    double t = (double)(end - start) / CLOCKS_PER_SEC;
-    printf("  Xoshiro: %.2f s (%.2f Mnums/s)\n", t, n / (t * 1e6));
-    rng_free(xoshiro);
+    for (int e = 0; e < NUM_ENGINES; e++) {
+        rng_state_t* rng = rng_init(engines[e].type, 12345, 0);
+        bench_start(&b);
+        for (int i = 0; i < n; i++) dummy ^= rng_next_uint64(rng);
+        bench_stop(&b, engines[e].name, n);
+
+        snprintf(name, sizeof(name), "%s bulk", engines[e].name);
+        bench_start(&b);
+        for (int i = 0; i < n; i += 4096) {
+            rng_fill_bytes(rng, buf, sizeof(buf));
+            dummy ^= buf[i & 4095];
+        }
+        bench_stop(&b, name, n);
+        rng_free(rng);
+    }
+
+    rng_state_t* mt = rng_init(RNG_MT19937, 12345, 0);
+    bench_start(&b);
+    for (int i = 0; i < n; i++) dummy ^= rng_next_uint32(mt);
+    bench_stop(&b, "MT19937 uint32", n);
+    rng_free(mt);
+
+    rng_shared_t* shared = rng_shared_init(RNG_XOSHIRO256PP, 12345, 0);
+    bench_start(&b);
+    for (int i = 0; i < n; i++) dummy ^= rng_shared_next_uint64(shared);
+    bench_stop(&b, "Xoshiro shared handle", n);
+    rng_shared_free(shared);
+
+    static double dbuf[4096];
+    rng_type_t dtypes[] = { RNG_XOSHIRO256PP, RNG_XOSHIRO256P, RNG_DSFMT };
+    const char* dnames[] = { "Xoshiro", "Xoshiro256+", "dSFMT" };
+    for (int e = 0; e < 3; e++) {
+        rng_state_t* rng = rng_init(dtypes[e], 12345, 0);
+        snprintf(name, sizeof(name), "%s fill_double", dnames[e]);
+        bench_start(&b);
+        for (int i = 0; i < n; i += 4096) {
+            rng_fill_double(rng, dbuf, 4096);
+            sink += dbuf[i & 4095];
+        }
+        bench_stop(&b, name, n);
+        rng_free(rng);
+    }
+
+    static const struct { rng_type_t type; rng_params_t params; const char* name; } dists[] = {
+        { RNG_GAUSSIAN, { .gaussian = {0.0, 1.0} }, "Gaussian (polar)" },
+        { RNG_GAMMA, { .gamma = {2.0, 1.0} }, "Gamma k=2" },
+        { RNG_GAMMA, { .gamma = {0.5, 1.0} }, "Gamma k=0.5" },
+        { RNG_WEIBULL, { .weibull = {1.5, 1.0} }, "Weibull" },
+        { RNG_POISSON, { .poisson = {4.0} }, "Poisson l=4" },
+        { RNG_TRUNC_NORMAL, { .trunc_normal = {0.0, 1.0, -1.0, 1.0} }, "Trunc normal [-1,1]" },
+        { RNG_TRUNC_NORMAL, { .trunc_normal = {0.0, 1.0, 1.0, INFINITY} }, "Trunc normal [1,inf)" },
+        { RNG_TRUNC_NORMAL, { .trunc_normal = {0.0, 1.0, 6.0, INFINITY} }, "Trunc normal [6,inf)" },
+        { RNG_TRUNC_NORMAL, { .trunc_normal = {0.0, 1.0, 20.0, INFINITY} }, "Trunc normal [20,inf)" },
+    };
+    for (int d = 0; d < (int)(sizeof(dists) / sizeof(dists[0])); d++) {
+        rng_params_t p = dists[d].params;
+        rng_state_t* rng = rng_init(dists[d].type, 12345, &p);
+        bench_start(&b);
+        for (int i = 0; i < nd; i++) sink += rng_next_distribution(rng);
+        bench_stop(&b, dists[d].name, nd);
+        rng_free(rng);
+    }
+
+    // the naive tail sampler for comparison: redraw normals until past 3
+    rng_params_t gp3 = { .gaussian = {0.0, 1.0} };
+    rng_state_t* g3 = rng_init(RNG_GAUSSIAN, 12345, &gp3);
+    bench_start(&b);
+    for (int i = 0; i < nd / 1000; i++) {
+        double z;
+        do z = rng_next_distribution(g3); while (z < 3.0);
+        sink += z;
+    }
+    bench_stop(&b, "Tail [3,inf) by rejection", nd / 1000);
+    rng_free(g3);
 
-    rng_state_t* pcg = rng_init(RNG_PCG32, 12345, 0);
-    start = clock();
-    for (int i = 0; i < n; i++) dummy ^= rng_next_uint64(pcg);
-    end = clock();
-    t = (double)(end - start) / CLOCKS_PER_SEC;
-    printf("  PCG32: %.2f s (%.2f Mnums/s)\n", t, n / (t * 1e6));
-    rng_free(pcg);
+    bench_start(&b);
+    for (int i = 0; i < n; i += 4096) {
+        rng_hash_fill(12345, 0, i, 4096, buf);
+        dummy ^= buf[i & 4095];
+    }
+    bench_stop(&b, "Hash fill", n);
+
+    // bytes per call: reservoir vs a fresh 64-bit draw each time
+    rng_state_t* rb = rng_init(RNG_XOSHIRO256PP, 12345, 0);
+    bench_start(&b);
+    for (int i = 0; i < n; i++) dummy += (uint8_t)rng_next_uint64(rb);
+    bench_stop(&b, "uint8 from uint64", n);
+    bench_start(&b);
+    for (int i = 0; i < n; i++) dummy += rng_next_uint8(rb);
+    bench_stop(&b, "uint8 reservoir", n);
+    bench_start(&b);
+    for (int i = 0; i < n; i++) dummy += rng_next_bounded(rb, 6);
+    bench_stop(&b, "bounded(6) reservoir", n);
+    rng_free(rb);
+
+    // consuming 32m doubles: per call, one big array, fused blocks
+    size_t nm = (size_t)32 << 20;
+    double* arr = malloc(nm * sizeof(double));
+    rng_state_t* rng = rng_init(RNG_XOSHIRO256PP, 12345, 0);
+    double acc = 0;
+    bench_start(&b);
+    for (size_t i = 0; i < nm; i++) acc += rng_next_double(rng);
+    bench_stop(&b, "Sum per call", nm);
+    if (arr) {
+        bench_start(&b);
+        rng_fill_double(rng, arr, nm);
+        for (size_t i = 0; i < nm; i++) acc += arr[i];
+        bench_stop(&b, "Sum fill then read", nm);
+    }
+    bench_start(&b);
+    rng_stream_blocks(rng, RNG_BLOCK_DOUBLE, nm, 0, sum_block, &acc);
+    bench_stop(&b, "Sum stream_blocks", nm);
+    sink += acc;
+    free(arr);
+    rng_free(rng);
+
+    // five-stage noise chain: fused pipeline vs one pass per stage
+    static const size_t nq = (size_t)16 << 20;
+    double* stage = malloc(nq * sizeof(double));
+    int16_t* q16 = malloc(nq * sizeof(int16_t));
+    if (stage && q16) {
+        rng_pipeline_t* chain = noise_chain(12345);
+        rng_pipeline_run(chain, q16, nq);  // touch the pages first
+        bench_start(&b);
+        rng_pipeline_run(chain, q16, nq);
+        bench_stop(&b, "Noise chain fused", nq);
+        rng_pipeline_free(chain);
+
+        rng_params_t gp = { .gaussian = {0.0, 1.0} };
+        rng_state_t* g = rng_init(RNG_GAUSSIAN, 12345, &gp);
+        rng_fill_distribution(g, stage, nq);
+        bench_start(&b);
+        rng_fill_distribution(g, stage, nq);
+        for (size_t i = 0; i < nq; i++) stage[i] = 3.0 * stage[i] + 1.0;
+        for (size_t i = 0; i < nq; i++) stage[i] = clampd(stage[i], -4.0, 6.0);
+        for (size_t i = 0; i < nq; i++) stage[i] = 0.5 * stage[i] - 0.25;
+        for (size_t i = 0; i < nq; i++) q16[i] = (int16_t)nearbyint(clampd(stage[i] * 1000.0, -32768.0, 32767.0));
+        bench_stop(&b, "Noise chain staged", nq);
+        dummy ^= (uint64_t)q16[nq - 1];
+        rng_free(g);
+    }
+    free(stage);
+    free(q16);
+
+    // stochastic rounding kernels vs one rng_next_double per element
+    float* fin = malloc(nq * sizeof(float));
+    uint16_t* h16 = malloc(nq * sizeof(uint16_t));
+    if (fin && h16) {
+        rng_state_t* rng = rng_init(RNG_XOSHIRO256PP, 12345, 0);
+        for (size_t i = 0; i < nq; i++) fin[i] = (float)i * 1e-3f;
+        rng_round_bf16(rng, fin, h16, nq);
+        bench_start(&b);
+        for (size_t i = 0; i < nq; i++) {
+            uint32_t bits;
+            memcpy(&bits, &fin[i], 4);
+            h16[i] = (uint16_t)((bits + (uint32_t)(rng_next_double(rng) * 65536.0)) >> 16);
+        }
+        bench_stop(&b, "bf16 round per call", nq);
+        bench_start(&b);
+        rng_round_bf16(rng, fin, h16, nq);
+        bench_stop(&b, "bf16 round", nq);
+        bench_start(&b);
+        rng_round_fp16(rng, fin, h16, nq);
+        bench_stop(&b, "fp16 round", nq);
+        bench_start(&b);
+        rng_round_int8(rng, fin, (int8_t*)h16, nq, 0.01f);
+        bench_stop(&b, "int8 round", nq);
+        bench_start(&b);
+        rng_dither_int16(rng, fin, (int16_t*)h16, nq, 1.0f);
+        bench_stop(&b, "TPDF dither int16", nq);
+        dummy ^= h16[nq - 1];
+        rng_free(rng);
+    }
+    free(fin);
+    free(h16);
+
+    // fault injection: cost per event, so sparse rates cover gigabits instantly
+    size_t fbytes = (size_t)256 << 20;
+    uint8_t* fbuf = calloc(fbytes, 1);
+    if (fbuf) {
+        double rates[] = { 1e-3, 1e-6, 1e-9 };
+        for (int r = 0; r < 3; r++) {
+            snprintf(name, sizeof(name), "Fault inject %.0e, Mbit scanned", rates[r]);
+            bench_start(&b);
+            uint64_t ev = rng_fault_inject_parallel(RNG_XOSHIRO256PP, 12345, fbuf, 8ULL * fbytes, rates[r], 1, 0);
+            bench_stop(&b, name, 8.0 * fbytes);
+            dummy ^= ev;
+        }
+        free(fbuf);
+    }
+
+    // weighted samples for a 6 sigma yield estimate, 8 dimensions
+    rng_is_t* isb = rng_is_create(8, 12345);
+    double is_shift[8];
+    for (int j = 0; j < 8; j++) is_shift[j] = 6.0 / sqrt(8);
+    rng_is_set_proposal(isb, is_shift, NULL);
+    rng_is_result_t isr;
+    bench_start(&b);
+    rng_is_estimate(isb, sum_score, NULL, 6.0 * sqrt(8), nd / 4, &isr);
+    bench_stop(&b, "IS weighted sample, 8-D", nd / 4);
+    sink += isr.estimate;
+    rng_is_free(isb);
+
+    // 1024 metropolis chains on an 8-d normal: batched lockstep vs one
+    // chain at a time with per-proposal library calls
+    enum { MC_K = 1024, MC_D = 8, MC_STEPS = 1000 };
+    rng_mcmc_t* mc = rng_mcmc_create(RNG_MCMC_MH, MC_K, MC_D, std_logp, NULL, 12345);
+    bench_start(&b);
+    rng_mcmc_run(mc, MC_STEPS, 0, NULL, 1);
+    bench_stop(&b, "MCMC chain-step, batched, 1 thread", (double)MC_K * MC_STEPS);
+    bench_start(&b);
+    rng_mcmc_run(mc, MC_STEPS, 0, NULL, 0);
+    bench_stop(&b, "MCMC chain-step, batched, all cpus", (double)MC_K * MC_STEPS);
+    rng_mcmc_free(mc);
+    {
+        rng_params_t np = { .gaussian = {0.0, 1.0} };
+        rng_state_t* ng = rng_init(RNG_GAUSSIAN, 12345, &np);
+        double x[MC_D] = { 0 }, y[MC_D], lp = 0, lq, step = 2.38 / sqrt(MC_D);
+        bench_start(&b);
+        for (int c = 0; c < MC_K; c++)
+            for (int s = 0; s < MC_STEPS; s++) {
+                for (int j = 0; j < MC_D; j++) y[j] = x[j] + step * rng_next_distribution(ng);
+                std_logp(y, 1, MC_D, &lq, NULL, NULL);
+                if (log(1.0 - rng_next_double(ng)) < lq - lp) {
+                    memcpy(x, y, sizeof(x));
+                    lp = lq;
+                }
+            }
+        bench_stop(&b, "MCMC chain-step, scalar", (double)MC_K * MC_STEPS);
+        sink += x[0];
+        rng_free(ng);
+    }
+
+    // resampling a million particles: kernels vs a draw and binary search each
+    enum { PF_N = 1 << 20 };
+    double* pw = malloc(PF_N * sizeof(double));
+    double* pc = malloc(PF_N * sizeof(double));
+    size_t* anc = malloc(PF_N * sizeof(size_t));
+    if (pw && pc && anc) {
+        rng_state_t* rng = rng_init(RNG_XOSHIRO256PP, 12345, 0);
+        rng_fill_double(rng, pw, PF_N);
+        static const char* rnames[] = { "Resample systematic", "Resample stratified", "Resample residual" };
+        for (int kind = RNG_RESAMPLE_SYSTEMATIC; kind <= RNG_RESAMPLE_RESIDUAL; kind++) {
+            bench_start(&b);
+            rng_resample(rng, kind, pw, PF_N, anc, PF_N, 0);
+            bench_stop(&b, rnames[kind], PF_N);
+            dummy ^= anc[PF_N / 2];
+        }
+        bench_start(&b);
+        double acc = 0;
+        for (int i = 0; i < PF_N; i++) pc[i] = acc += pw[i];
+        for (int j = 0; j < PF_N; j++) {
+            double u = rng_next_double(rng) * acc;
+            size_t lo = 0, hi = PF_N - 1;
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (pc[mid] <= u) lo = mid + 1;
+                else hi = mid;
+            }
+            anc[j] = lo;
+        }
+        bench_stop(&b, "Resample per-particle search", PF_N);
+        dummy ^= anc[PF_N / 2];
+        rng_free(rng);
+    }
+    free(pw);
+    free(pc);
+    free(anc);
+
+    // a pair of 1024 x 1024 correlated fields per transform
+    {
+        rng_cov_params_t cp = { 1.0, 20.0 };
+        rng_field_t* f = rng_field_create(1024, 1024, 1.0, rng_cov_exponential, &cp, 12345, 0);
+        double* fa = malloc(1024 * 1024 * sizeof(double));
+        double* fb = malloc(1024 * 1024 * sizeof(double));
+        if (f && fa && fb) {
+            bench_start(&b);
+            for (int r = 0; r < 2; r++) rng_field_generate(f, fa, fb);
+            bench_stop(&b, "Field 1024^2, points", 4.0 * 1024 * 1024);
+            sink += fa[12345] + fb[54321];
+        }
+        free(fa);
+        free(fb);
+        rng_field_free(f);
+    }
+
+    // ar(2) noise, 4m samples: scalar recursion, one long series, 64 series
+    {
+        enum { AR_N = 1 << 22 };
+        double phi[2] = { 0.5, -0.3 }, x1 = 0, x2 = 0;
+        double* ar = malloc(AR_N * sizeof(double));
+        rng_params_t np = { .gaussian = {0.0, 1.0} };
+        rng_state_t* ng = rng_init(RNG_GAUSSIAN, 12345, &np);
+        bench_start(&b);
+        for (int t = 0; t < AR_N; t++) {
+            double x = phi[0] * x1 + phi[1] * x2 + rng_next_distribution(ng);
+            ar[t] = x; x2 = x1; x1 = x;
+        }
+        bench_stop(&b, "AR(2) scalar recursion", AR_N);
+        rng_free(ng);
+        rng_arma_t* a1 = rng_arma_create(2, phi, 0, NULL, 1.0, 1, 12345);
+        bench_start(&b);
+        rng_arma_generate(a1, ar, AR_N, 0);
+        bench_stop(&b, "AR(2) 1 series, block scan", AR_N);
+        rng_arma_t* a64 = rng_arma_create(2, phi, 0, NULL, 1.0, 64, 12345);
+        bench_start(&b);
+        rng_arma_generate(a64, ar, AR_N / 64, 0);
+        bench_stop(&b, "AR(2) 64 series SoA", AR_N);
+        sink += ar[AR_N / 2];
+        rng_arma_free(a1);
+        rng_arma_free(a64);
+        free(ar);
+    }
+
+    // project 512 points from 4096 to 256 dims: a materialized gaussian
+    // matrix (8 mb) and plain multiply vs the lazy operator for each kind
+    {
+        enum { SN = 512, SD = 4096, SK = 256 };
+        double* sx = malloc((size_t)SN * SD * sizeof(double));
+        double* sy = malloc((size_t)SN * SK * sizeof(double));
+        double* sr = malloc((size_t)SD * SK * sizeof(double));
+        rng_params_t np = { .gaussian = {0.0, 1.0} };
+        rng_state_t* ng = rng_init(RNG_GAUSSIAN, 12345, &np);
+        if (sx && sy && sr && ng) {
+            rng_fill_distribution(ng, sx, (size_t)SN * SD);
+            rng_sketch_t* sg = rng_sketch_create(RNG_SKETCH_GAUSSIAN, SD, SK, 0.0, 12345);
+            bench_start(&b);
+            rng_sketch_rows(sg, 0, SD, sr);
+            memset(sy, 0, (size_t)SN * SK * sizeof(double));
+            for (int i = 0; i < SN; i++)
+                for (int t = 0; t < SD; t++) {
+                    double v = sx[(size_t)i * SD + t];
+                    for (int j = 0; j < SK; j++) sy[i * SK + j] += v * sr[(size_t)t * SK + j];
+                }
+            bench_stop(&b, "Sketch gaussian, materialized", (double)SN * SD);
+            sink += sy[SK + 1];
+            rng_sketch_free(sg);
+            static const char* names[] = { "Sketch gaussian, lazy", "Sketch rademacher, lazy",
+                                           "Sketch achlioptas 1/64, lazy" };
+            for (int kind = RNG_SKETCH_GAUSSIAN; kind <= RNG_SKETCH_ACHLIOPTAS; kind++) {
+                rng_sketch_t* s = rng_sketch_create(kind, SD, SK, 0.0, 12345);
+                bench_start(&b);
+                rng_sketch_apply(s, sx, SN, sy, 0);
+                bench_stop(&b, names[kind], (double)SN * SD);
+                sink += sy[SK + 1];
+                rng_sketch_free(s);
+            }
+        }
+        rng_free(ng);
+        free(sx);
+        free(sy);
+        free(sr);
+    }
+
+    // gillespie-style loop: draw a reaction, change two propensities.
+    // fenwick updates vs rebuilding the cdf every step.
+    enum { REACTIONS = 10000, STEPS = 100000 };
+    double* prop = malloc(REACTIONS * sizeof(double));
+    double* cdf = malloc(REACTIONS * sizeof(double));
+    if (prop && cdf) {
+        rng_state_t* rng = rng_init(RNG_XOSHIRO256PP, 12345, 0);
+        for (int i = 0; i < REACTIONS; i++) prop[i] = rng_next_double(rng) + 0.01;
+        rng_weighted_t* wt = rng_weighted_create(REACTIONS, prop);
+        bench_start(&b);
+        for (int s = 0; s < STEPS; s++) {
+            size_t r = rng_weighted_sample(wt, rng);
+            rng_weighted_update(wt, r, rng_next_double(rng) + 0.01);
+            rng_weighted_update(wt, (r * 7 + 1) % REACTIONS, rng_next_double(rng) + 0.01);
+        }
+        bench_stop(&b, "Gillespie step, fenwick", STEPS);
+        rng_weighted_free(wt);
+
+        bench_start(&b);
+        for (int s = 0; s < STEPS; s++) {
+            double acc = 0;
+            for (int i = 0; i < REACTIONS; i++) cdf[i] = acc += prop[i];
+            double u = rng_next_double(rng) * acc;
+            size_t lo = 0, hi = REACTIONS - 1;
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (cdf[mid] <= u) lo = mid + 1;
+                else hi = mid;
+            }
+            prop[lo] = rng_next_double(rng) + 0.01;
+            prop[(lo * 7 + 1) % REACTIONS] = rng_next_double(rng) + 0.01;
+        }
+        bench_stop(&b, "Gillespie step, CDF rebuild", STEPS);
+        rng_free(rng);
+    }
+    free(prop);
+    free(cdf);
+
+    // fill sizes from l1 up to dram, cached vs streaming stores. the largest
+    // size defaults to 64 mb, RNG_BENCH_MAX_MB raises it (8192 for 8 gb).
+    size_t max_bytes = (size_t)64 << 20;
+    const char* env = getenv("RNG_BENCH_MAX_MB");
+    if (env && atol(env) > 0) max_bytes = (size_t)atol(env) << 20;
+    uint8_t* big = NULL;
+    if (posix_memalign((void**)&big, 64, max_bytes)) big = NULL;
+    rng_state_t* aes = rng_init(RNG_AES128CTR, 12345, 0);
+    printf("  Fill sweep (AES128-CTR, default streaming threshold %zu KB):\n", rng_nt_threshold() >> 10);
+    for (size_t size = 4096; big && size <= max_bytes; size *= 4) {
+        size_t reps = ((size_t)1 << 30) / size;
+        if (reps < 1) reps = 1;
+        double gbs[2];
+        for (int nt = 0; nt < 2; nt++) {
+            rng_set_nt_threshold(nt ? 1 : SIZE_MAX);
+            rng_fill_bytes(aes, big, size);  // touch the pages first
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            for (size_t r = 0; r < reps; r++) rng_fill_bytes(aes, big, size);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            double t = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+            gbs[nt] = (double)size * reps / (t * 1e9);
+            dummy ^= big[size - 1];
+        }
+        if (size < ((size_t)1 << 20)) printf("    %8zu KB: cached %6.2f GB/s, streaming %6.2f GB/s\n", size >> 10, gbs[0], gbs[1]);
+        else printf("    %8zu MB: cached %6.2f GB/s, streaming %6.2f GB/s\n", size >> 20, gbs[0], gbs[1]);
+    }
+    rng_set_nt_threshold(0);
+    rng_free(aes);
+    free(big);
+
+    // the same output through the simd and scalar kernels: aes portable /
+    // aes-ni / vaes, dsfmt scalar / sse2 recursion
+    {
+        enum { KN = 1 << 20 };
+        uint64_t* kb = malloc(KN * sizeof(uint64_t));
+        int saved_aes = aes_kernel_level(), saved_dsfmt = dsfmt_kernel_level();
+        static const char* aes_names[] = { "AES128-CTR portable", "AES128-CTR AES-NI", "AES128-CTR VAES" };
+        for (int level = 0; kb && level <= aes_hw_available(); level++) {
+            aes_set_kernel(level);
+            rng_state_t* r = rng_init(RNG_AES128CTR, 12345, 0);
+            bench_start(&b);
+            for (int rep = 0; rep < (level ? 64 : 1); rep++) rng_fill_bytes(r, kb, KN * sizeof(uint64_t));
+            bench_stop(&b, aes_names[level], (level ? 64.0 : 1.0) * KN);
+            dummy ^= kb[KN - 1];
+            rng_free(r);
+        }
+        aes_set_kernel(saved_aes);
+        for (int simd = 0; kb && simd < 2; simd++) {
+            dsfmt_set_kernel(simd);
+            rng_state_t* r = rng_init(RNG_DSFMT, 12345, 0);
+            bench_start(&b);
+            for (int rep = 0; rep < 16; rep++) rng_fill_double(r, (double*)kb, KN);
+            bench_stop(&b, simd ? "dSFMT fill_double SSE2" : "dSFMT fill_double scalar", 16.0 * KN);
+            sink += ((double*)kb)[KN - 1];
+            rng_free(r);
+        }
+        dsfmt_set_kernel(saved_dsfmt);
+        free(kb);
+    }
+
+    enum { SCALE_TASKS = 4096 };
+    static double res[SCALE_TASKS];
+    double t1 = 0;
+    for (int th = 1; th <= 128 && th <= rng_num_cpus(); th *= 2) {
+        snprintf(name, sizeof(name), "Tasks on %3d threads", th);
+        bench_start(&b);
+        rng_run_tasks(RNG_XOSHIRO256PP, 12345, 0, SCALE_TASKS, th, sum_task, res);
+        double t = bench_stop(&b, name, SCALE_TASKS * 7000.0);
+        if (th == 1) t1 = t;
+        printf("    speedup %.2fx\n", t1 / t);
+    }
+    bench_close(&b);
+    if (dummy == 42 && sink == 42) printf("\n");  // keep results live
 }
 
 void print_hist(double* bins, int num_bins) {